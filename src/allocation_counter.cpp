@@ -0,0 +1,45 @@
+#include "stats.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+
+// Allocations
+// counted by replacing the global operator new, which counts every allocation of the process. The aligned versions
+// are replaced too, since the default ones don't go through operator new(std::size_t). Only built into the executables
+// reading the counts, calculator_test and calculator_bench, so that programs linking calccore keep their allocator
+#if defined(CALC_STATS)
+namespace {
+	using calc::stats::Counter;
+
+	void* allocate(std::size_t size, std::size_t alignment) {
+		calc::stats::add(Counter::Allocations);
+		calc::stats::add(Counter::BytesAllocated, size);
+		if (size == 0) size = 1;
+		void* memory;
+		if (alignment <= alignof(std::max_align_t)) memory = std::malloc(size);
+		else memory = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+		if (memory == nullptr) throw std::bad_alloc();
+		return memory;
+	}
+}
+
+void* operator new(std::size_t size) { return allocate(size, alignof(std::max_align_t)); }
+void* operator new[](std::size_t size) { return allocate(size, alignof(std::max_align_t)); }
+void* operator new(std::size_t size, std::align_val_t alignment) {
+	return allocate(size, static_cast<std::size_t>(alignment));
+}
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+	return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept { std::free(memory); }
+#endif
@@ -0,0 +1,352 @@
+#include "calculator.h"
+#include "stats.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <new>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Times the lexer, the parser, evaluation and calculate() separately over generated corpora, and calculate() with
+// sharing of repeated subexpressions enabled, and counts the heap allocations each of them makes. Every corpus is
+// generated from a fixed seed, so runs on the same build only differ by their timings.
+// Usage: calculator_bench [--json] [--min-time <seconds per measurement>] [--corpus <name>]
+
+#if defined(CALC_STATS)
+namespace {
+    std::size_t countAllocations() { return calc::stats::snapshot()[calc::stats::Counter::Allocations]; }
+}
+#else
+namespace {
+    std::size_t numAllocations = 0; // counted by the replaced operator new below
+
+    std::size_t countAllocations() { return numAllocations; }
+}
+
+void* operator new(std::size_t size) { // allocation_counter.cpp replaces it when built with CALC_STATS
+    ++numAllocations;
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+#endif
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct Corpus {
+        std::string name;
+        std::vector<std::string> expressions;
+        std::size_t numBytes = 0;
+    };
+
+    class Generator {
+    public:
+        explicit Generator(std::uint64_t seed): random(seed) {}
+
+        unsigned int below(unsigned int bound) {
+            return std::uniform_int_distribution<unsigned int>(0, bound - 1)(random);
+        }
+
+        std::string literal(unsigned int minDigits, unsigned int maxDigits) {
+            const unsigned int numDigits = minDigits + below(maxDigits - minDigits + 1);
+            std::string digits(1, static_cast<char>('1' + below(9)));
+            while (digits.size() < numDigits) digits += static_cast<char>('0' + below(10));
+            return digits;
+        }
+
+        char binaryOperator() { return "+-*/"[below(4)]; }
+
+        // a few operands, with the occasional unary minus, parentheses and spaces, like a person would type
+        std::string shortExpression() {
+            std::string expression;
+            const unsigned int numOperands = 2 + below(7);
+            unsigned int numOpen = 0;
+            for (unsigned int i = 0; i < numOperands; ++i) {
+                if (i != 0) {
+                    if (below(4) == 0) expression += ' ';
+                    expression += binaryOperator();
+                    if (below(4) == 0) expression += ' ';
+                }
+                if (below(6) == 0) expression += '-';
+                if (below(5) == 0) {
+                    expression += '(';
+                    ++numOpen;
+                }
+                expression += literal(1, 4);
+                if (numOpen != 0 && below(3) == 0) {
+                    expression += ')';
+                    --numOpen;
+                }
+            }
+            expression.append(numOpen, ')');
+            return expression;
+        }
+
+        std::string longLiteralExpression() {
+            std::string expression = literal(15, 200);
+            for (unsigned int i = below(4); i > 0; --i) {
+                expression += binaryOperator();
+                expression += literal(15, 200);
+            }
+            return expression;
+        }
+
+        // digit, operator and parentheses around the rest, hundreds of levels deep
+        std::string deepExpression() {
+            const unsigned int maxDepth = calc::MAX_DEPTH < 400 ? calc::MAX_DEPTH : 400;
+            const unsigned int depth = maxDepth / 4 + below(maxDepth - maxDepth / 4 + 1);
+            std::string expression;
+            for (unsigned int level = 0; level < depth; ++level) {
+                expression += static_cast<char>('1' + below(9));
+                expression += "+-*"[below(3)];
+                expression += '(';
+            }
+            expression += literal(1, 3);
+            expression.append(depth, ')');
+            return expression;
+        }
+
+        std::string wideSum() {
+            std::string expression = literal(1, 6);
+            for (unsigned int i = 500 + below(1501); i > 0; --i) {
+                expression += below(2) == 0 ? '+' : '-';
+                expression += literal(1, 6);
+            }
+            return expression;
+        }
+
+        // like generated inputs, a sum of the same few parenthesized subexpressions repeated hundreds of times
+        std::string repeatedExpression() {
+            std::string parts[4];
+            for (std::string& part : parts) part = '(' + shortExpression() + ')';
+            std::string expression = parts[0];
+            for (unsigned int i = 200 + below(301); i > 0; --i) {
+                expression += below(2) == 0 ? '+' : '-';
+                expression += parts[below(4)];
+            }
+            return expression;
+        }
+
+        // short expressions broken in one of the ways the lexer, the parser or evaluation reject
+        std::string invalidExpression() {
+            std::string expression = shortExpression();
+            const std::size_t at = below(static_cast<unsigned int>(expression.size()));
+            switch (below(8)) {
+            case 0: expression.insert(at, 1, "a#.x"[below(4)]); break;
+            case 1: expression.insert(0, "("); break;
+            case 2: expression += ')'; break;
+            case 3: expression += binaryOperator(); break;
+            case 4: expression += "/0"; break;
+            case 5: expression += "*()"; break;
+            case 6: expression.insert(at, "*/"); break;
+            default: expression += '*' + literal(301, 320); break;
+            }
+            return expression;
+        }
+
+    private:
+        std::mt19937_64 random;
+    };
+
+    template <typename Make>
+    Corpus generate(const char* name, std::size_t numExpressions, Make&& make) {
+        Corpus corpus;
+        corpus.name = name;
+        for (std::size_t i = 0; i < numExpressions; ++i) {
+            corpus.expressions.push_back(make());
+            corpus.numBytes += corpus.expressions.back().size();
+        }
+        return corpus;
+    }
+
+    struct Measurement {
+        std::string corpus;
+        std::string phase;
+        std::size_t numOperations = 0; // per pass over the corpus
+        std::size_t numBytes = 0; // per pass
+        double nsPerOperation = 0;
+        double allocationsPerOperation = 0;
+        double operationsPerSecond = 0;
+        double megabytesPerSecond = 0;
+    };
+
+    volatile double sink; // keeps the results of the measured operations alive
+
+    // runs pass() once to warm up, then again until minTime seconds went by. pass() returns a value derived from all
+    // its results, so that none of the work can be optimized away
+    template <typename Pass>
+    Measurement measure(const std::string& corpus, const char* phase, std::size_t numOperations, std::size_t numBytes,
+                        double minTime, Pass&& pass) {
+        sink = pass();
+
+        std::size_t numPasses = 0;
+        const std::size_t allocationsBefore = countAllocations();
+        const Clock::time_point start = Clock::now();
+        double elapsed = 0;
+        do {
+            sink = pass();
+            ++numPasses;
+            elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        } while (elapsed < minTime);
+        const std::size_t allocations = countAllocations() - allocationsBefore;
+
+        Measurement measurement;
+        measurement.corpus = corpus;
+        measurement.phase = phase;
+        measurement.numOperations = numOperations;
+        measurement.numBytes = numBytes;
+        const double totalOperations = static_cast<double>(numOperations) * static_cast<double>(numPasses);
+        if (totalOperations != 0) {
+            measurement.nsPerOperation = elapsed * 1e9 / totalOperations;
+            measurement.allocationsPerOperation = static_cast<double>(allocations) / totalOperations;
+            measurement.operationsPerSecond = totalOperations / elapsed;
+        }
+        measurement.megabytesPerSecond = static_cast<double>(numBytes) * static_cast<double>(numPasses) / elapsed / 1e6;
+        return measurement;
+    }
+
+    // reads every token of expression the way the parser does, without building anything
+    std::size_t lex(std::string_view expression) {
+        calc::classes::Lexer lex(expression);
+        std::size_t numTokens = 0;
+        while (lex.getError() == calc::ErrorCode::None && lex.getPosition() < expression.size()) {
+            if (calc::utils::isDigit(*lex)) lex.digits();
+            else ++lex;
+            ++numTokens;
+        }
+        return numTokens;
+    }
+
+    void measureCorpus(const Corpus& corpus, double minTime, std::vector<Measurement>& measurements) {
+        const std::vector<std::string>& expressions = corpus.expressions;
+
+        measurements.push_back(measure(corpus.name, "lex", expressions.size(), corpus.numBytes, minTime, [&] {
+            std::size_t numTokens = 0;
+            for (const std::string& expression : expressions) numTokens += lex(expression);
+            return static_cast<double>(numTokens);
+        }));
+
+        calc::classes::FlatAST tree;
+        measurements.push_back(measure(corpus.name, "parse", expressions.size(), corpus.numBytes, minTime, [&] {
+            std::size_t numNodes = 0;
+            for (const std::string& expression : expressions) {
+                calc::Result result;
+                Calculator::parse(expression, tree, result);
+                numNodes += tree.size() + static_cast<std::size_t>(result.error);
+            }
+            return static_cast<double>(numNodes);
+        }));
+
+        // only the expressions that parse can be evaluated, so the evaluate phase has fewer operations on invalid ones
+        std::vector<calc::classes::FlatAST> trees;
+        std::size_t numParsedBytes = 0;
+        for (const std::string& expression : expressions) {
+            calc::Result result;
+            Calculator::parse(expression, tree, result);
+            if (!result) continue;
+            trees.push_back(tree);
+            numParsedBytes += expression.size();
+        }
+        measurements.push_back(measure(corpus.name, "evaluate", trees.size(), numParsedBytes, minTime, [&] {
+            double sum = 0;
+            for (const calc::classes::FlatAST& parsed : trees) {
+                calc::classes::Number answer;
+                unsigned int errorOffset = 0;
+                if (parsed.tryEvaluate(answer, errorOffset) == calc::ErrorCode::None)
+                    sum += calc::utils::roundAnswer(answer);
+                else sum += errorOffset;
+            }
+            return sum;
+        }));
+
+        Calculator calc;
+        measurements.push_back(measure(corpus.name, "calculate", expressions.size(), corpus.numBytes, minTime, [&] {
+            double sum = 0;
+            for (const std::string& expression : expressions) {
+                try { sum += calc.calculate(expression); }
+                catch (const std::exception&) { sum += 1; }
+            }
+            return sum;
+        }));
+
+        Calculator sharingCalc;
+        sharingCalc.enableSharing(true);
+        measurements.push_back(measure(corpus.name, "shared", expressions.size(), corpus.numBytes, minTime, [&] {
+            double sum = 0;
+            for (const std::string& expression : expressions) {
+                try { sum += sharingCalc.calculate(expression); }
+                catch (const std::exception&) { sum += 1; }
+            }
+            return sum;
+        }));
+    }
+
+    void printTable(const std::vector<Measurement>& measurements) {
+        std::printf("%-14s %-10s %12s %12s %14s %10s\n", "corpus", "phase", "ns/op", "allocs/op", "ops/s", "MB/s");
+        for (const Measurement& m : measurements) {
+            std::printf("%-14s %-10s %12.1f %12.3f %14.0f %10.1f\n", m.corpus.c_str(), m.phase.c_str(),
+                        m.nsPerOperation, m.allocationsPerOperation, m.operationsPerSecond, m.megabytesPerSecond);
+        }
+    }
+
+    // one object per measurement, in a fixed order, so that two runs can be diffed line by line
+    void printJson(const std::vector<Measurement>& measurements, double minTime) {
+        std::printf("{\n  \"engine\": \"%s\",\n  \"maxDigits\": %u,\n  \"maxDepth\": %u,\n  \"minTime\": %g,\n"
+                    "  \"measurements\": [\n", Calculator::getEngine(), calc::MAX_DIGITS, calc::MAX_DEPTH, minTime);
+        for (std::size_t i = 0; i < measurements.size(); ++i) {
+            const Measurement& m = measurements[i];
+            std::printf("    {\"corpus\": \"%s\", \"phase\": \"%s\", \"operations\": %zu, \"bytes\": %zu, "
+                        "\"nsPerOp\": %.2f, \"allocsPerOp\": %.4f, \"opsPerSecond\": %.0f, \"mbPerSecond\": %.2f}%s\n",
+                        m.corpus.c_str(), m.phase.c_str(), m.numOperations, m.numBytes, m.nsPerOperation,
+                        m.allocationsPerOperation, m.operationsPerSecond, m.megabytesPerSecond,
+                        i + 1 == measurements.size() ? "" : ",");
+        }
+        std::printf("  ]\n}\n");
+    }
+}
+
+int main(int argc, char* argv[]) {
+    bool isJson = false;
+    double minTime = 0.5;
+    std::string onlyCorpus;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view argument = argv[i];
+        if (argument == "--json") isJson = true;
+        else if (argument == "--min-time" && i + 1 < argc) minTime = std::strtod(argv[++i], nullptr);
+        else if (argument == "--corpus" && i + 1 < argc) onlyCorpus = argv[++i];
+        else {
+            std::fprintf(stderr, "Usage: %s [--json] [--min-time <seconds per measurement>] [--corpus <name>]\n",
+                         argv[0]);
+            return 2;
+        }
+    }
+
+    Generator generator(42);
+    std::vector<Corpus> corpora;
+    corpora.push_back(generate("short", 4096, [&] { return generator.shortExpression(); }));
+    corpora.push_back(generate("long-literal", 1024, [&] { return generator.longLiteralExpression(); }));
+    corpora.push_back(generate("deep-nesting", 256, [&] { return generator.deepExpression(); }));
+    corpora.push_back(generate("wide-sum", 64, [&] { return generator.wideSum(); }));
+    corpora.push_back(generate("error-heavy", 4096, [&] { return generator.invalidExpression(); }));
+    corpora.push_back(generate("repeated", 64, [&] { return generator.repeatedExpression(); }));
+
+    std::vector<Measurement> measurements;
+    for (const Corpus& corpus : corpora) {
+        if (onlyCorpus.empty() || onlyCorpus == corpus.name) measureCorpus(corpus, minTime, measurements);
+    }
+    if (measurements.empty()) {
+        std::fprintf(stderr, "Unknown corpus: %s\n", onlyCorpus.c_str());
+        return 2;
+    }
+
+    if (isJson) printJson(measurements, minTime);
+    else printTable(measurements);
+}
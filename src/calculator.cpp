@@ -1,55 +1,275 @@
 #include "calculator.h"
+#include "columnar.h"
+#include "formula.h"
+#include "result_cache.h"
+#include "stats.h"
 
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <limits>
 #include <memory>
 #include <stdexcept>
 #include <string>
 #include <string_view>
 #include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+// Results
+std::string calc::errorMessage(ErrorCode error) {
+	switch (error) {
+	case ErrorCode::None: return "";
+	case ErrorCode::EmptyExpression: return "Expression is empty";
+	case ErrorCode::InvalidCharacter: return "Invalid character found";
+	case ErrorCode::InvalidUnaryOperator: return "Invalid unary * or / found";
+	case ErrorCode::AdjacentOperators: return "Invalid adjacent operators found";
+	case ErrorCode::LeadingOperator: return "Leading operator found";
+	case ErrorCode::UnmatchedOpenParenthesis: return "Unmatched open parenthesis found";
+	case ErrorCode::UnmatchedClosedParenthesis: return "Closed parenthesis with no open match found";
+	case ErrorCode::EmptyParentheses: return "Empty parentheses found";
+	case ErrorCode::NestingTooDeep:
+		return "Parentheses nested too deeply found (currently limited to " + std::to_string(MAX_DEPTH) + " levels)";
+	case ErrorCode::MissingOperator: return "Missing operator next to variable found";
+	case ErrorCode::UndefinedVariable: return "Undefined variable found";
+	case ErrorCode::Overflow: return utils::overflowErrorMessage();
+	case ErrorCode::DivisionByZero: return "Division by zero detected";
+	}
+	return "Unknown error";
+}
 
 
 // Utilities
+// tables are filled once, by the same std::pow and std::log10 calls that getScientificMagnitude(), makeScientific() and
+// rawValue() used to make every time. Writing the powers down as constants instead would change answers: glibc's
+// std::pow(10, 23) for example isn't the closest double to 10 ^ 23
+calc::utils::PowerTables::PowerTables() {
+	for (int exponent = MIN_POWER; exponent <= MAX_POWER; ++exponent)
+		powers[exponent - MIN_POWER] = std::pow(10, exponent);
+
+	const auto hasMagnitude = [](std::uint64_t bits, int exponent) {
+		double x;
+		std::memcpy(&x, &bits, sizeof(x));
+		return std::floor(std::log10(x)) >= exponent;
+	};
+	for (int exponent = MIN_THRESHOLD; exponent <= MAX_THRESHOLD; ++exponent) {
+		// positive doubles are ordered like their bits, so binary search the bits. At 10 ^ exponent / 2 the magnitude
+		// is exponent - 1 for sure, and at 10 ^ exponent * 2 it is exponent for sure
+		std::uint64_t low, high;
+		const double lowValue = powers[exponent - MIN_POWER] / 2;
+		const double highValue = powers[exponent - MIN_POWER] * 2;
+		std::memcpy(&low, &lowValue, sizeof(low));
+		std::memcpy(&high, &highValue, sizeof(high));
+		while (high - low > 1) {
+			const std::uint64_t middle = low + (high - low) / 2;
+			(hasMagnitude(middle, exponent) ? high : low) = middle;
+		}
+		std::memcpy(&thresholds[exponent - MIN_THRESHOLD], &high, sizeof(high));
+	}
+}
+
+const calc::utils::PowerTables& calc::utils::getPowerTables() {
+	static const PowerTables tables;
+	return tables;
+}
+
 int calc::utils::getScientificMagnitude(double value) {
 	if (value == 0.0) return 0;
-	return std::floor(std::log10(std::abs(value)));
+
+	std::uint64_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	const auto biasedExponent = static_cast<int>((bits >> 52) & 0x7FF);
+	if (biasedExponent == 0x7FF) return std::numeric_limits<int>::min(); // infinite or NaN
+	if (biasedExponent == 0) return std::floor(std::log10(std::abs(value))); // subnormal
+
+	// with 2 ^ e <= |value| < 2 ^ (e + 1), floor(e * log10(2)) is the magnitude or one less than it. 78913 / 2 ^ 18 is
+	// log10(2) rounded up enough to give the exact floor for every exponent of a double
+	const int binaryExponent = biasedExponent - 1023;
+	const int magnitude = (binaryExponent * 78913) >> 18;
+	const double absValue = std::abs(value);
+	const PowerTables& tables = getPowerTables();
+	return absValue >= tables.thresholds[magnitude + 1 - PowerTables::MIN_THRESHOLD] ? magnitude + 1 : magnitude;
+}
+
+double calc::utils::powerOfTen(int exponent) {
+	if (exponent < PowerTables::MIN_POWER || exponent > PowerTables::MAX_POWER) return std::pow(10, exponent);
+	return getPowerTables().powers[exponent - PowerTables::MIN_POWER];
 }
 
 std::string calc::utils::overflowErrorMessage() {
 	return "Value limit exceeded (currently set to 10 ^ " + std::to_string(MAX_MAGNITUDE) + ")";
 }
 
+void calc::utils::throwError(ErrorCode error) {
+	switch (error) {
+	case ErrorCode::Overflow:
+		stats::add(stats::Counter::OverflowErrors);
+		throw std::overflow_error(errorMessage(error));
+
+	case ErrorCode::DivisionByZero:
+		stats::add(stats::Counter::DomainErrors);
+		throw std::domain_error(errorMessage(error));
+
+	case ErrorCode::None: throw std::logic_error("No error to throw in throwError function");
+
+	default:
+		stats::add(stats::Counter::InvalidArgumentErrors);
+		throw std::invalid_argument(errorMessage(error));
+	}
+}
+
+namespace {
+	// |magnitude| without overflowing for the INT_MIN of infinities and NaN, which stays above every bound
+	unsigned int absoluteMagnitude(unsigned int magnitude) {
+		return magnitude > static_cast<unsigned int>(std::numeric_limits<int>::max()) ? 0u - magnitude : magnitude;
+	}
+}
+
 bool calc::utils::isBounded(double value) {
-	return static_cast<unsigned int>( std::abs( getScientificMagnitude(value) ) ) <= MAX_MAGNITUDE;
+	return absoluteMagnitude(static_cast<unsigned int>(getScientificMagnitude(value))) <= MAX_MAGNITUDE;
 }
 
 bool calc::utils::isProductBounded(int magnitude1, int magnitude2) {
-	return static_cast<unsigned int>( std::abs(magnitude1 + magnitude2) ) <= MAX_MAGNITUDE;
+	// the sum wraps around instead of overflowing when a magnitude is INT_MIN, and stays out of bounds
+	return absoluteMagnitude(static_cast<unsigned int>(magnitude1) + static_cast<unsigned int>(magnitude2))
+		<= MAX_MAGNITUDE;
 	// magnitude of product isn't always equal to sum of magnitudes, but this is fine when MAX_MAGNITUDE is so large
 }
 
-bool calc::utils::isDigit(char c) {
-	constexpr std::string_view NUMS = "0123456789";
-	return NUMS.find(c) != std::string::npos;
+std::size_t calc::utils::skipDigits(std::string_view text, std::size_t pos) {
+#if defined(__SSE2__)
+	const __m128i zero = _mm_set1_epi8('0');
+	const __m128i nine = _mm_set1_epi8(9);
+	for (; pos + 16 <= text.size(); pos += 16) {
+		const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + pos));
+		const __m128i offsets = _mm_sub_epi8(chars, zero); // digits become 0 to 9, everything else wraps above 9
+		const __m128i isDigitMask = _mm_cmpeq_epi8(_mm_min_epu8(offsets, nine), offsets);
+		const auto nonDigits = static_cast<unsigned int>(~_mm_movemask_epi8(isDigitMask)) & 0xFFFF;
+		if (nonDigits != 0) return pos + __builtin_ctz(nonDigits);
+	}
+#endif
+	while (pos < text.size() && isDigit(text[pos])) ++pos;
+	return pos;
 }
 
-bool calc::utils::isOperator(char c) {
-	constexpr std::string_view OPS = "+-*/";
-	return OPS.find(c) != std::string::npos;
+std::size_t calc::utils::skipSpaces(std::string_view text, std::size_t pos) {
+	if (pos >= text.size() || text[pos] != ' ') return pos; // usually there is no space at all, so check that first
+#if defined(__SSE2__)
+	const __m128i space = _mm_set1_epi8(' ');
+	for (; pos + 16 <= text.size(); pos += 16) {
+		const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + pos));
+		const auto nonSpaces = static_cast<unsigned int>(~_mm_movemask_epi8(_mm_cmpeq_epi8(chars, space))) & 0xFFFF;
+		if (nonSpaces != 0) return pos + __builtin_ctz(nonSpaces);
+	}
+#endif
+	while (pos < text.size() && text[pos] == ' ') ++pos;
+	return pos;
 }
 
 calc::classes::ScientificValue calc::utils::makeScientific(double value, unsigned int lastDigit) {
 	// function rounds to MAX_DIGITS + 1 by default. After last evaluation, calculate() will call makeScientific() to
 	// round to MAX_DIGITS. This will guarantee that repeating values are rounded properly, like 0.9999999... = 1
+	stats::addLocal(stats::Counter::MakeScientificCalls);
 	if (value == 0.0) return {0.0, 0};
 	int magnitude = getScientificMagnitude(value);
-	int rounded = static_cast<int>(lastDigit) - 1 - magnitude;
-	double exponent = std::pow(10, rounded);
+	// wraps around for infinities and NaN, which give NaN whatever the power of ten
+	int rounded = static_cast<int>(lastDigit - 1 - static_cast<unsigned int>(magnitude));
+	double exponent = powerOfTen(rounded);
 	value = std::round(value * exponent) / exponent;
-	value = value / std::pow(10, magnitude);
+	value = value / powerOfTen(magnitude);
 	return {value, magnitude};
 }
 
+calc::ErrorCode calc::utils::addOrSubtract(
+	const classes::ScientificValue& left, const classes::ScientificValue& right, bool isSub,
+	classes::ScientificValue& result) {
+	const double raw_left = left.rawValue();
+	const double raw_right = right.rawValue();
+	const double raw_sum = isSub ? raw_left - raw_right : raw_left + raw_right ;
+
+	if (!isBounded(raw_sum))
+		return ErrorCode::Overflow;
+
+	result = makeScientific(raw_sum);
+	return ErrorCode::None;
+}
+
+calc::ErrorCode calc::utils::multiplyOrDivide(
+	const classes::ScientificValue& left, const classes::ScientificValue& right, bool isDiv,
+	classes::ScientificValue& result) {
+	if (isDiv) {
+		if (right.value == 0.0)
+			return ErrorCode::DivisionByZero;
+
+		int right_mag_inverse = -right.magnitude;
+		if (!isProductBounded(left.magnitude, right_mag_inverse))
+			return ErrorCode::Overflow;
+
+		const double quotient = left.rawValue() / right.rawValue();
+		result = makeScientific(quotient);
+		return ErrorCode::None;
+	}
+
+
+	if (!isProductBounded(left.magnitude, right.magnitude))
+		return ErrorCode::Overflow;
+
+	const double product = left.rawValue() * right.rawValue();
+	result = makeScientific(product);
+	return ErrorCode::None;
+}
+
+namespace {
+	calc::classes::Number toNumber(__int128 exact) { // exact is a sum or product of two long longs
+		if (exact >= -calc::classes::Number::MAX_INTEGER && exact <= calc::classes::Number::MAX_INTEGER)
+			return calc::classes::Number(static_cast<long long>(exact));
+		// too large for a long long, but nowhere near MAX_MAGNITUDE, and still exact until this one rounding
+		return calc::classes::Number(calc::utils::makeScientific(static_cast<double>(exact)));
+	}
+}
+
+calc::ErrorCode calc::utils::addOrSubtract(
+	const classes::Number& left, const classes::Number& right, bool isSub, classes::Number& result) {
+	if (left.isInteger && right.isInteger) {
+		long long sum;
+		const bool isOverflow = isSub
+			? __builtin_sub_overflow(left.integer, right.integer, &sum)
+			: __builtin_add_overflow(left.integer, right.integer, &sum);
+		if (!isOverflow) result = toNumber(sum);
+		else result = toNumber(isSub ? __int128{left.integer} - right.integer : __int128{left.integer} + right.integer);
+		return ErrorCode::None;
+	}
+
+	classes::ScientificValue scientific;
+	const ErrorCode error = addOrSubtract(left.toScientific(), right.toScientific(), isSub, scientific);
+	if (error == ErrorCode::None) result = classes::Number(scientific);
+	return error;
+}
+
+calc::ErrorCode calc::utils::multiplyOrDivide(
+	const classes::Number& left, const classes::Number& right, bool isDiv, classes::Number& result) {
+	if (!isDiv && left.isInteger && right.isInteger) {
+		long long product;
+		if (!__builtin_mul_overflow(left.integer, right.integer, &product)) result = toNumber(product);
+		else result = toNumber(__int128{left.integer} * right.integer);
+		return ErrorCode::None;
+	}
+
+	classes::ScientificValue scientific;
+	const ErrorCode error = multiplyOrDivide(left.toScientific(), right.toScientific(), isDiv, scientific);
+	if (error == ErrorCode::None) result = classes::Number(scientific);
+	return error;
+}
+
+double calc::utils::roundAnswer(const classes::Number& answer) {
+	const double value = answer.isInteger ? static_cast<double>(answer.integer) : answer.toScientific().rawValue();
+	return makeScientific(value,MAX_DIGITS).rawValue();
+}
+
 // Calculator Inner Classes
 // defined in a top-level namespace for easier implementation
 // AST
@@ -58,7 +278,7 @@ calc::classes::ScientificValue::ScientificValue(double val, int m): value(val),
 calc::classes::ScientificValue calc::classes::ScientificValue::evaluate() { return *this; }
 
 double calc::classes::ScientificValue::rawValue() const {
-	return value * std::pow(10.0, magnitude);
+	return value * utils::powerOfTen(magnitude);
 }
 
 calc::classes::Negation::Negation(std::unique_ptr<ASTNode>&& o): operand(std::move(o)) {}
@@ -74,19 +294,12 @@ calc::classes::ScientificValue calc::classes::Negation::evaluate() {
 }
 
 calc::classes::ScientificValue calc::classes::AddOrSubtract::evaluate() {
-	using namespace utils;
-
 	const ScientificValue left_val = left->evaluate();
 	const ScientificValue right_val = right->evaluate();
-
-	const double raw_left = left_val.rawValue();
-	const double raw_right = right_val.rawValue();
-	const double raw_sum = isSub ? raw_left - raw_right : raw_left + raw_right ;
-
-	if (!isBounded(raw_sum))
-		throw std::overflow_error(overflowErrorMessage());
-
-	return makeScientific(raw_sum);
+	ScientificValue result(0.0, 0);
+	const ErrorCode error = utils::addOrSubtract(left_val, right_val, isSub, result);
+	if (error != ErrorCode::None) utils::throwError(error);
+	return result;
 }
 
 calc::classes::MultiplyOrDivide::MultiplyOrDivide(
@@ -94,41 +307,593 @@ calc::classes::MultiplyOrDivide::MultiplyOrDivide(
 	: left(std::move(l)), right(std::move(r)), isDiv(b) {}
 
 calc::classes::ScientificValue calc::classes::MultiplyOrDivide::evaluate() {
-	using namespace utils;
-
 	const ScientificValue left_val = left->evaluate();
 	const ScientificValue right_val = right->evaluate();
+	ScientificValue result(0.0, 0);
+	const ErrorCode error = utils::multiplyOrDivide(left_val, right_val, isDiv, result);
+	if (error != ErrorCode::None) utils::throwError(error);
+	return result;
+}
 
+calc::classes::TreeBuilder::Node calc::classes::TreeBuilder::value(const ScientificValue& val) {
+	return std::make_unique<ScientificValue>(val);
+}
 
-	if (isDiv) {
-		if (right_val.value == 0.0)
-			throw std::domain_error("Division by zero detected");
+calc::classes::TreeBuilder::Node calc::classes::TreeBuilder::negation(Node&& operand) {
+	return std::make_unique<Negation>(std::move(operand));
+}
 
-		int right_mag_inverse = -right_val.magnitude;
-		if (!isProductBounded(left_val.magnitude, right_mag_inverse))
-			throw std::overflow_error(overflowErrorMessage());
+calc::classes::TreeBuilder::Node calc::classes::TreeBuilder::addOrSubtract(
+	Node&& left, Node&& right, bool isSub, unsigned int) {
+	return std::make_unique<AddOrSubtract>(std::move(left), std::move(right), isSub);
+}
+
+calc::classes::TreeBuilder::Node calc::classes::TreeBuilder::multiplyOrDivide(
+	Node&& left, Node&& right, bool isDiv, unsigned int) {
+	return std::make_unique<MultiplyOrDivide>(std::move(left), std::move(right), isDiv);
+}
+
+
+// Number
+calc::classes::ScientificValue calc::classes::Number::toScientific() const {
+	if (!isInteger) return {value, magnitude};
+	return utils::makeScientific(static_cast<double>(integer)); // exact up to 2 ^ 53 like Literal::toScientific()
+}
+
+calc::classes::Number calc::classes::Number::negated() const {
+	Number negation = *this;
+	if (isInteger) negation.integer = -integer;
+	else negation.value = -value;
+	return negation;
+}
+
+
+// Flat AST
+namespace {
+	std::uint64_t hashNode(const calc::classes::FlatNode& node) {
+		// positions are left out, so that the same subexpression anywhere in the expression gets the same hash
+		std::uint64_t hash = static_cast<std::uint64_t>(node.type);
+		hash = hash * 0x9E3779B97F4A7C15ULL + node.left;
+		hash = hash * 0x9E3779B97F4A7C15ULL + node.right;
+		if (node.type == calc::classes::NodeType::Value) {
+			std::uint64_t bits = static_cast<std::uint64_t>(node.constant.integer);
+			if (!node.constant.isInteger) {
+				std::memcpy(&bits, &node.constant.value, sizeof(bits));
+				bits += static_cast<std::uint64_t>(static_cast<unsigned int>(node.constant.magnitude)) << 1 | 1;
+			}
+			hash = hash * 0x9E3779B97F4A7C15ULL + bits;
+		}
+		return hash ^ (hash >> 29);
+	}
+
+	bool isSameNode(const calc::classes::FlatNode& a, const calc::classes::FlatNode& b) {
+		if (a.type != b.type || a.left != b.left || a.right != b.right) return false;
+		if (a.type != calc::classes::NodeType::Value) return true;
+		const calc::classes::Number& x = a.constant;
+		const calc::classes::Number& y = b.constant;
+		if (x.isInteger != y.isInteger) return false;
+		if (x.isInteger) return x.integer == y.integer;
+		return std::memcmp(&x.value, &y.value, sizeof(x.value)) == 0 && x.magnitude == y.magnitude; // 0 isn't -0
+	}
+}
+
+void calc::classes::FlatAST::clear() {
+	nodes.clear();
+	steps.clear();
+	names.clear();
+	if (++generation == 0) { // after 2 ^ 32 clears, empty the slots for real once
+		for (Slot& slot : slots) slot.generation = 0;
+		generation = 1;
+	}
+}
+
+void calc::classes::FlatAST::enableSharing(bool isEnabled) {
+	clear();
+	isSharing = isEnabled;
+	if (!isEnabled) slots = {};
+}
+
+calc::classes::FlatAST::Node calc::classes::FlatAST::append(NodeType type, Node left, Node right, unsigned int position) {
+	nodes.push_back({type, left, right, position, {}});
+	return isSharing ? intern() : root();
+}
+
+calc::classes::FlatAST::Node calc::classes::FlatAST::appendOperation(
+	NodeType type, Node left, Node right, unsigned int position) {
+	// right is the last node, and left the one before it. A constant right operand becomes a step instead, of the
+	// Fold that left already is or of a new one. That Fold is the last one created, since any later one would come
+	// after it in the tree, so its steps are still the last ones. Sharing changes nodes once they are appended, so
+	// no folds are made with it
+	if (isSharing || nodes[right].type != NodeType::Value) return append(type, left, right, position);
+	const Number constant = nodes[right].constant;
+	nodes.pop_back();
+	if (nodes[left].type != NodeType::Fold)
+		nodes.push_back({NodeType::Fold, left, static_cast<unsigned int>(steps.size()), 0, {}});
+	steps.push_back({type, position, constant});
+	++nodes.back().position;
+	return root();
+}
+
+calc::classes::FlatAST::Node calc::classes::FlatAST::value(const Number& val) {
+	nodes.push_back({NodeType::Value, 0, 0, 0, val});
+	return isSharing ? intern() : root();
+}
+
+calc::classes::FlatAST::Node calc::classes::FlatAST::intern() {
+	// the parser appends nodes in post-order, so the identical node found here is the first occurrence of the
+	// subexpression, with the positions of its operators. Evaluating each node once, in the order of the tree, then
+	// fails at the same node and offset as evaluating every occurrence in post-order
+	if (2 * nodes.size() > slots.size()) rehash();
+	const FlatNode& node = nodes.back();
+	const std::size_t mask = slots.size() - 1;
+	for (std::size_t i = hashNode(node) & mask;; i = (i + 1) & mask) {
+		Slot& slot = slots[i];
+		if (slot.generation != generation) {
+			slot = {root(), generation};
+			return root();
+		}
+		if (isSameNode(nodes[slot.node], node)) {
+			nodes.pop_back();
+			return slot.node;
+		}
+	}
+}
 
-		const double quotient = left_val.rawValue() / right_val.rawValue();
-		return makeScientific(quotient);
+void calc::classes::FlatAST::rehash() {
+	// every node but the last one is already unique, so they only need a free slot
+	std::size_t size = 64;
+	while (size < 4 * nodes.size()) size *= 2;
+	slots.assign(size, {0, 0});
+	const std::size_t mask = size - 1;
+	for (Node n = 0; n + 1 < nodes.size(); ++n) {
+		std::size_t i = hashNode(nodes[n]) & mask;
+		while (slots[i].generation == generation) i = (i + 1) & mask;
+		slots[i] = {n, generation};
 	}
+}
+
+calc::classes::FlatAST::Node calc::classes::FlatAST::variable(std::string_view name, unsigned int position) {
+	Node index = 0; // expressions only have a few variables, so a linear search is enough
+	while (index < names.size() && names[index] != name) ++index;
+	if (index == names.size()) names.emplace_back(name);
+	return append(NodeType::Variable, index, 0, position);
+}
+
+calc::classes::FlatAST::Node calc::classes::FlatAST::negation(Node operand) {
+	return append(NodeType::Negation, operand, 0, 0);
+}
 
+calc::classes::FlatAST::Node calc::classes::FlatAST::addOrSubtract(
+	Node left, Node right, bool isSub, unsigned int position) {
+	return appendOperation(isSub ? NodeType::Subtract : NodeType::Add, left, right, position);
+}
 
-	if (!isProductBounded(left_val.magnitude, right_val.magnitude))
-		throw std::overflow_error(overflowErrorMessage());
+calc::classes::FlatAST::Node calc::classes::FlatAST::multiplyOrDivide(
+	Node left, Node right, bool isDiv, unsigned int position) {
+	return appendOperation(isDiv ? NodeType::Divide : NodeType::Multiply, left, right, position);
+}
 
-	const double product = left_val.rawValue() * right_val.rawValue();
-	return makeScientific(product);
+calc::classes::Number calc::classes::FlatAST::evaluate() const {
+	Number answer;
+	unsigned int errorOffset;
+	const ErrorCode error = tryEvaluate(answer, errorOffset);
+	if (error != ErrorCode::None) utils::throwError(error);
+	return answer;
+}
+
+calc::ErrorCode calc::classes::FlatAST::tryEvaluate(Number& answer, unsigned int& errorOffset) const {
+	if (isSharing) return tryEvaluateShared(answer, errorOffset);
+
+	// nodes are in post-order and every subtree is contiguous, the left one first, so a single pass over them with a
+	// stack of values evaluates the tree without recursing, however deep it is. The first node to fail is also the
+	// first one a recursive evaluation would fail at: anywhere in the left subtree, then in the right one, and only
+	// then at the operation itself
+	thread_local std::vector<Number> stack; // reused by every evaluation of the calling thread
+	stack.clear();
+	for (const FlatNode& node : nodes) {
+		ErrorCode error = ErrorCode::None;
+		switch (node.type) {
+		case NodeType::Value:
+			stack.push_back(node.constant);
+			continue;
+
+		case NodeType::Variable:
+			errorOffset = node.position;
+			return ErrorCode::UndefinedVariable;
+
+		case NodeType::Negation:
+			stack.back() = stack.back().negated();
+			continue;
+
+		case NodeType::Add:
+		case NodeType::Subtract: {
+			const Number right = stack.back();
+			stack.pop_back();
+			error = utils::addOrSubtract(stack.back(), right, node.type == NodeType::Subtract, stack.back());
+			break;
+		}
+
+		case NodeType::Multiply:
+		case NodeType::Divide: {
+			const Number right = stack.back();
+			stack.pop_back();
+			error = utils::multiplyOrDivide(stack.back(), right, node.type == NodeType::Divide, stack.back());
+			break;
+		}
+
+		case NodeType::Fold: {
+			// each step is the operation a node would have been, in the same order, so it fails at the same partial
+			// result and offset
+			Number& partial = stack.back();
+			const FoldStep* step = &steps[node.right];
+			for (const FoldStep* const end = step + node.position; step != end; ++step) {
+				error = step->type == NodeType::Add || step->type == NodeType::Subtract
+					? utils::addOrSubtract(partial, step->constant, step->type == NodeType::Subtract, partial)
+					: utils::multiplyOrDivide(partial, step->constant, step->type == NodeType::Divide, partial);
+				if (error != ErrorCode::None) {
+					errorOffset = step->position;
+					return error;
+				}
+			}
+			continue;
+		}
+		}
+
+		if (error != ErrorCode::None) {
+			errorOffset = node.position;
+			return error;
+		}
+	}
+
+	if (stack.size() != 1) throw std::logic_error("Unbalanced stack in FlatAST::tryEvaluate method");
+	answer = stack[0];
+	return ErrorCode::None;
+}
+
+calc::ErrorCode calc::classes::FlatAST::tryEvaluateShared(Number& answer, unsigned int& errorOffset) const {
+	// a node can have several parents, so each node's value is kept for all of them instead of on a stack. Nodes come
+	// after their children, so one pass in order still evaluates everything, and each node only once
+	thread_local std::vector<Number> values; // reused by every evaluation of the calling thread
+	values.resize(nodes.size());
+	for (Node n = 0; n < nodes.size(); ++n) {
+		const FlatNode& node = nodes[n];
+		ErrorCode error = ErrorCode::None;
+		switch (node.type) {
+		case NodeType::Value: values[n] = node.constant; continue;
+
+		case NodeType::Variable:
+			errorOffset = node.position;
+			return ErrorCode::UndefinedVariable;
+
+		case NodeType::Negation: values[n] = values[node.left].negated(); continue;
+
+		case NodeType::Add:
+		case NodeType::Subtract:
+			error = utils::addOrSubtract(values[node.left], values[node.right], node.type == NodeType::Subtract,
+			                             values[n]);
+			break;
+
+		case NodeType::Multiply:
+		case NodeType::Divide:
+			error = utils::multiplyOrDivide(values[node.left], values[node.right], node.type == NodeType::Divide,
+			                                values[n]);
+			break;
+
+		case NodeType::Fold: throw std::logic_error("Unexpected fold in FlatAST::tryEvaluateShared method");
+		}
+
+		if (error != ErrorCode::None) {
+			errorOffset = node.position;
+			return error;
+		}
+	}
+
+	if (nodes.empty()) throw std::logic_error("Empty tree in FlatAST::tryEvaluateShared method");
+	answer = values[root()];
+	return ErrorCode::None;
+}
+
+void calc::classes::FlatAST::simplify() {
+	if (nodes.empty()) return;
+
+	// first pass: rebuild the tree into scratch, where remap[n] is the simplified version of node n. Every node is
+	// appended after its children, so scratch stays in post-order, but nodes that got folded into others stay behind
+	scratch.clear();
+	remap.resize(nodes.size());
+	for (Node n = 0; n < nodes.size(); ++n) {
+		const FlatNode& node = nodes[n];
+		switch (node.type) {
+		case NodeType::Value:
+		case NodeType::Variable:
+			scratch.push_back(node);
+			remap[n] = static_cast<Node>(scratch.size() - 1);
+			break;
+
+		case NodeType::Negation:
+			remap[n] = simplifiedNegation(remap[node.left]);
+			break;
+
+		case NodeType::Fold: { // expanded into the operations its steps were made from
+			Node partial = remap[node.left];
+			for (std::size_t s = node.right; s < node.right + node.position; ++s) {
+				const FoldStep& step = steps[s];
+				scratch.push_back({NodeType::Value, 0, 0, 0, step.constant});
+				partial = simplifiedOperation(step.type, partial, static_cast<Node>(scratch.size() - 1), step.position);
+			}
+			remap[n] = partial;
+			break;
+		}
+
+		default: remap[n] = simplifiedOperation(node.type, remap[node.left], remap[node.right], node.position);
+		}
+	}
+
+	// second pass: copy back only the nodes reachable from the new root. They all come before it in scratch, so the
+	// root ends up last again
+	constexpr Node UNREACHABLE = 0;
+	constexpr Node REACHABLE = 1;
+	const Node newRoot = remap[root()];
+	remap.assign(newRoot + 1, UNREACHABLE);
+	remap[newRoot] = REACHABLE;
+	for (Node n = newRoot + 1; n-- > 0;) {
+		if (remap[n] == UNREACHABLE) continue;
+		const FlatNode& node = scratch[n];
+		if (node.type == NodeType::Value || node.type == NodeType::Variable) continue;
+		remap[node.left] = REACHABLE;
+		if (node.type != NodeType::Negation) remap[node.right] = REACHABLE;
+	}
+
+	nodes.clear();
+	steps.clear();
+	for (Node n = 0; n <= newRoot; ++n) {
+		if (remap[n] == UNREACHABLE) continue;
+		FlatNode node = scratch[n];
+		if (node.type != NodeType::Value && node.type != NodeType::Variable) {
+			node.left = remap[node.left];
+			if (node.type != NodeType::Negation) node.right = remap[node.right];
+		}
+		nodes.push_back(node);
+		remap[n] = root(); // from here on, remap[n] is the position of scratch node n in the simplified tree
+	}
+}
+
+calc::classes::FlatAST::Node calc::classes::FlatAST::simplifiedNegation(Node operand) {
+	switch (scratch[operand].type) {
+	case NodeType::Value: {
+		FlatNode node = scratch[operand];
+		node.constant = node.constant.negated();
+		scratch.push_back(node);
+		return static_cast<Node>(scratch.size() - 1);
+	}
+
+	case NodeType::Negation: return scratch[operand].left;
+
+	default:
+		scratch.push_back({NodeType::Negation, operand, 0, 0, {}});
+		return static_cast<Node>(scratch.size() - 1);
+	}
+}
+
+calc::classes::FlatAST::Node calc::classes::FlatAST::simplifiedOperation(
+	NodeType type, Node left, Node right, unsigned int position) {
+	// x - (-y) = x + y and x + (-y) = x - y exactly, since negating a value only flips its sign
+	bool isNegated = false;
+	if (type == NodeType::Add || type == NodeType::Subtract) {
+		if (scratch[right].type == NodeType::Negation) {
+			right = scratch[right].left;
+			type = type == NodeType::Add ? NodeType::Subtract : NodeType::Add;
+		}
+	}
+	// (-x) * y = -(x * y), and the same for division, because rounding and bounds checks are symmetric around 0.
+	// The only difference is a product of 0 turning into -0, which every later operation and the last rounding in
+	// calculate() turn back into 0. Negations moved up this way can then cancel out or be absorbed by + and -
+	else {
+		if (scratch[left].type == NodeType::Negation) { left = scratch[left].left; isNegated = !isNegated; }
+		if (scratch[right].type == NodeType::Negation) { right = scratch[right].left; isNegated = !isNegated; }
+	}
+
+	const FlatNode& left_node = scratch[left];
+	const FlatNode& right_node = scratch[right];
+	bool isFolded = false;
+	if (left_node.type == NodeType::Value && right_node.type == NodeType::Value) {
+		// x + 0 and x * 1 can't be dropped unless x is a constant: they still round x again and can still overflow
+		// when x is a product of magnitude MAX_MAGNITUDE + 1, so they are only removed here by folding
+		// an operation that fails stays in the tree so that evaluation raises its error
+		Number val;
+		isFolded = ErrorCode::None == ((type == NodeType::Add || type == NodeType::Subtract)
+			? utils::addOrSubtract(left_node.constant, right_node.constant, type == NodeType::Subtract, val)
+			: utils::multiplyOrDivide(left_node.constant, right_node.constant, type == NodeType::Divide, val));
+		if (isFolded) scratch.push_back({NodeType::Value, 0, 0, 0, val});
+	}
+	if (!isFolded) scratch.push_back({type, left, right, position, {}});
+	const auto result = static_cast<Node>(scratch.size() - 1);
+
+	return isNegated ? simplifiedNegation(result) : result;
+}
+
+
+// Program
+void calc::classes::Program::assign(const FlatAST& tree) {
+	// nodes of a FlatAST are already in post-order, so each node becomes one instruction in the same order, and each
+	// step of a fold the two instructions of its constant and operation
+	if (tree.isShared()) throw std::logic_error("Unexpected shared nodes in Program::assign method");
+	clear();
+	code.reserve(tree.size());
+	positions.reserve(tree.size());
+	for (FlatAST::Node n = 0; n < tree.size(); ++n) {
+		const FlatNode& node = tree[n];
+		switch (node.type) {
+		case NodeType::Value: append({OpCode::Push, node.constant}, node.position); break;
+		case NodeType::Negation: append({OpCode::Negate, {}}, node.position); break;
+		case NodeType::Add: append({OpCode::Add, {}}, node.position); break;
+		case NodeType::Subtract: append({OpCode::Subtract, {}}, node.position); break;
+		case NodeType::Multiply: append({OpCode::Multiply, {}}, node.position); break;
+		case NodeType::Divide: append({OpCode::Divide, {}}, node.position); break;
+		case NodeType::Variable: throw std::logic_error("Unexpected variable in Program::assign method");
+		case NodeType::Fold:
+			for (std::size_t s = node.right; s < node.right + node.position; ++s) {
+				const FoldStep& step = tree.step(s);
+				const OpCode op = step.type == NodeType::Add ? OpCode::Add
+					: step.type == NodeType::Subtract ? OpCode::Subtract
+					: step.type == NodeType::Multiply ? OpCode::Multiply : OpCode::Divide;
+				append({OpCode::Push, step.constant}, 0);
+				append({op, {}}, step.position);
+			}
+			break;
+		}
+	}
+}
+
+void calc::classes::Program::append(const Instruction& instruction, unsigned int position) {
+	code.push_back(instruction);
+	positions.push_back(position);
+	if (instruction.op == OpCode::Push) {
+		if (++depth > maxStackSize) maxStackSize = depth;
+	}
+	else if (instruction.op != OpCode::Negate) --depth; // binary operations pop two values and push one
+}
+
+calc::classes::Number calc::classes::Program::execute(std::vector<Number>& stack) const {
+	Number answer;
+	unsigned int errorOffset;
+	const ErrorCode error = tryExecute(stack, answer, errorOffset);
+	if (error != ErrorCode::None) utils::throwError(error);
+	return answer;
+}
+
+calc::ErrorCode calc::classes::Program::tryExecute(
+	std::vector<Number>& stack, Number& answer, unsigned int& errorOffset) const {
+	if (stack.size() < maxStackSize) stack.resize(maxStackSize);
+
+	std::size_t top = 0; // number of values on the stack
+	ErrorCode error = ErrorCode::None;
+	for (std::size_t i = 0; i < code.size(); ++i) {
+		const Instruction& instruction = code[i];
+		switch (instruction.op) {
+		case OpCode::Push:
+			stack[top++] = instruction.constant;
+			break;
+
+		case OpCode::Negate:
+			stack[top - 1] = stack[top - 1].negated();
+			break;
+
+		case OpCode::Add:
+		case OpCode::Subtract:
+			--top;
+			error = utils::addOrSubtract(
+				stack[top - 1], stack[top], instruction.op == OpCode::Subtract, stack[top - 1]);
+			break;
+
+		case OpCode::Multiply:
+		case OpCode::Divide:
+			--top;
+			error = utils::multiplyOrDivide(
+				stack[top - 1], stack[top], instruction.op == OpCode::Divide, stack[top - 1]);
+			break;
+		}
+
+		if (error != ErrorCode::None) {
+			errorOffset = positions[i];
+			return error;
+		}
+	}
+
+	if (top != 1) throw std::logic_error("Unbalanced stack in Program::tryExecute method");
+	answer = stack[0];
+	return ErrorCode::None;
+}
+
+
+// Literal
+namespace {
+	unsigned long long parseEightDigits(const char* digits) {
+		// SWAR: combines pairs of digits, then pairs of pairs, then pairs of quadruples inside one 64-bit integer
+		unsigned long long chunk;
+		std::memcpy(&chunk, digits, sizeof(chunk));
+		chunk = ((chunk & 0x0F0F0F0F0F0F0F0FULL) * 2561) >> 8;
+		chunk = ((chunk & 0x00FF00FF00FF00FFULL) * 6553601) >> 16;
+		return ((chunk & 0x0000FFFF0000FFFFULL) * 42949672960001ULL) >> 32;
+	}
+
+	constexpr unsigned long long POWERS_OF_TEN[] = {
+		1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL,
+		10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+		1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL, 1000000000000000000ULL,
+		10000000000000000000ULL
+	};
+}
+
+void calc::classes::Literal::append(std::string_view digits) {
+	std::size_t i = 0;
+	if (numSignificantDigits == 0)
+		while (i < digits.size() && digits[i] == '0') ++i;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	while (i + 8 <= digits.size() && numSignificantDigits + 8 <= MAX_EXACT_DIGITS) {
+		leadingDigits = leadingDigits * POWERS_OF_TEN[8] + parseEightDigits(digits.data() + i);
+		numSignificantDigits += 8;
+		i += 8;
+	}
+#endif
+	for (; i < digits.size() && numSignificantDigits < MAX_EXACT_DIGITS; ++i, ++numSignificantDigits)
+		leadingDigits = leadingDigits * 10 + static_cast<unsigned long long>(digits[i] - '0');
+
+	numSignificantDigits += static_cast<unsigned int>(digits.size() - i); // only counted past MAX_EXACT_DIGITS
+}
+
+calc::ErrorCode calc::classes::Literal::toScientific(bool isNegative, ScientificValue& result) const {
+	if (numSignificantDigits <= MAX_EXACT_DIGITS) {
+		// converting to double is exact up to 2 ^ 53 and correctly rounded above it, and no such value is out of bounds
+		double operand = static_cast<double>(leadingDigits);
+		if (isNegative) operand = -operand;
+		result = utils::makeScientific(operand);
+		return ErrorCode::None;
+	}
+
+	// round to the first MAX_DIGITS + 1 digits, half away from zero like makeScientific()
+	constexpr unsigned int KEPT_DIGITS = MAX_DIGITS + 1;
+	const unsigned long long kept = leadingDigits / POWERS_OF_TEN[MAX_EXACT_DIGITS - KEPT_DIGITS - 1];
+	unsigned long long mantissa = kept / 10 + (kept % 10 >= 5 ? 1 : 0);
+	int magnitude = static_cast<int>(numSignificantDigits) - 1;
+	if (mantissa == POWERS_OF_TEN[KEPT_DIGITS]) {
+		mantissa = POWERS_OF_TEN[KEPT_DIGITS - 1];
+		++magnitude;
+	}
+	if (magnitude > static_cast<int>(MAX_MAGNITUDE)) return ErrorCode::Overflow;
+
+	const double value = static_cast<double>(mantissa) / static_cast<double>(POWERS_OF_TEN[KEPT_DIGITS - 1]);
+	result = {isNegative ? -value : value, magnitude};
+	return ErrorCode::None;
+}
+
+calc::ErrorCode calc::classes::Literal::toScientific(bool isNegative, Number& result) const {
+	constexpr auto MAX_INTEGER = static_cast<unsigned long long>(Number::MAX_INTEGER);
+	if (numSignificantDigits <= MAX_EXACT_DIGITS && leadingDigits <= MAX_INTEGER) {
+		const auto integer = static_cast<long long>(leadingDigits);
+		result = Number(isNegative ? -integer : integer);
+		return ErrorCode::None;
+	}
+
+	ScientificValue scientific;
+	const ErrorCode error = toScientific(isNegative, scientific);
+	if (error == ErrorCode::None) result = Number(scientific);
+	return error;
 }
 
 
 // Lexer
-calc::classes::Lexer::Lexer(const std::string& e)
+calc::classes::Lexer::Lexer(std::string_view e, bool allowVariables)
 	: expression(e)
 	, numOpenPars(0)
 	, isDelayed(false)
 	, current(SENTINEL_CHAR)
 	, last(SENTINEL_CHAR)
 	, delayed(SENTINEL_CHAR)
+	, error(ErrorCode::None)
+	, errorOffset(0)
+	, isVariablesAllowed(allowVariables)
+	, numTokens(0)
 {
 	for (idx = 0; idx < expression.length(); ++idx) { // point Lexer to first valid token
 		switch (expression[idx]) {
@@ -136,10 +901,12 @@ calc::classes::Lexer::Lexer(const std::string& e)
 
 		case '*':
 		case '/':
-			throw std::invalid_argument("Invalid unary * or / found");
+			fail(ErrorCode::InvalidUnaryOperator, idx);
+			return;
 
 		case ')':
-			throw std::invalid_argument("Closed parenthesis with no open match found");
+			fail(ErrorCode::UnmatchedClosedParenthesis, idx);
+			return;
 
 		case '(':
 			++numOpenPars;
@@ -157,35 +924,52 @@ calc::classes::Lexer::Lexer(const std::string& e)
 		case '+':
 		case '-':
 			current = expression[idx];
+			numTokens = 1;
 			return;
 
-		default: throw std::invalid_argument("Invalid character found");
+		default:
+			if (isVariablesAllowed && utils::isLetter(expression[idx])) {
+				current = expression[idx];
+				numTokens = 1;
+			}
+			else fail(ErrorCode::InvalidCharacter, idx);
+			return;
 		}
 	}
 
-	throw std::invalid_argument("Expression is empty");
+	fail(ErrorCode::EmptyExpression, idx);
+}
+
+void calc::classes::Lexer::fail(ErrorCode e, unsigned int offset) {
+	if (error != ErrorCode::None) return;
+	error = e;
+	errorOffset = offset;
+	current = ERROR_CHAR;
 }
 
 void calc::classes::Lexer::operator++() {
 	using namespace utils;
 
+    if (error != ErrorCode::None) return;
+
     if (isDelayed) {
         isDelayed = false;
         current = delayed;
     }
 
-    do ++idx; while (idx < expression.length() && expression[idx] == ' ');
+    idx = static_cast<unsigned int>(utils::skipSpaces(expression, idx + 1));
 
     last = current;
     if (idx >= expression.length()) {
-        if (numOpenPars != 0) throw std::invalid_argument("Unmatched open parenthesis found");
-        if (isOperator(last)) throw std::invalid_argument("Leading operator found");
+        if (numOpenPars != 0) return fail(ErrorCode::UnmatchedOpenParenthesis, idx);
+        if (isOperator(last)) return fail(ErrorCode::LeadingOperator, idx);
 
         current = ')'; // for first iteration of parseExpression() to stop at ')'
         return;
     }
 
     current = expression[idx];
+    ++numTokens;
     switch (current) {
         case '0':
         case '1':
@@ -197,6 +981,7 @@ void calc::classes::Lexer::operator++() {
         case '7':
         case '8':
         case '9':
+            if (isLetter(last)) return fail(ErrorCode::MissingOperator, idx);
             if (last == ')') {
                 isDelayed = true;
                 delayed = current;
@@ -211,12 +996,13 @@ void calc::classes::Lexer::operator++() {
         case '*':
         case '/':
             if (last == '(')
-                throw std::invalid_argument("Invalid unary * or / found");
+                return fail(ErrorCode::InvalidUnaryOperator, idx);
             if (isOperator(last))
-                throw std::invalid_argument("Invalid adjacent operators found");
+                return fail(ErrorCode::AdjacentOperators, idx);
             break;
 
         case '(':
+            if (isLetter(last)) return fail(ErrorCode::MissingOperator, idx);
             if (last == ')' || isDigit(last)) {
                 isDelayed = true;
                 delayed = current;
@@ -227,121 +1013,311 @@ void calc::classes::Lexer::operator++() {
 
         case ')':
             if (numOpenPars == 0)
-                throw std::invalid_argument("Closed parenthesis with no open match found");
-            if (isOperator(last)) throw std::invalid_argument("Leading operator found");
-            if (last == '(') throw std::invalid_argument("Empty parentheses found");
+                return fail(ErrorCode::UnmatchedClosedParenthesis, idx);
+            if (isOperator(last)) return fail(ErrorCode::LeadingOperator, idx);
+            if (last == '(') return fail(ErrorCode::EmptyParentheses, idx);
             --numOpenPars;
             break;
 
-        default: throw std::invalid_argument("Invalid character found");
+        default:
+            if (!isVariablesAllowed || !isLetter(current)) return fail(ErrorCode::InvalidCharacter, idx);
+            if (last == ')' || isDigit(last) || isLetter(last)) return fail(ErrorCode::MissingOperator, idx);
+            break;
     }
 }
 
 
-// Calculator
-double Calculator::calculate(const std::string& expression) {
-	auto ASTree = parse(expression);
-	ScientificValue answer = ASTree->evaluate();
-	answer = calc::utils::makeScientific(answer.rawValue(),calc::MAX_DIGITS);
-	lastAnswer = answer.rawValue();
-	lastExpression = expression;
-	return lastAnswer;
+std::string_view calc::classes::Lexer::digits() {
+	// moving from a digit to the next digit has no effect apart from moving, so jump straight to the last digit and
+	// let operator++ handle the token after it
+	const unsigned int begin = idx;
+	const auto end = static_cast<unsigned int>(utils::skipDigits(expression, idx));
+	idx = end - 1;
+	current = expression[idx];
+	operator++();
+	return expression.substr(begin, end - begin);
 }
 
+std::string_view calc::classes::Lexer::name() {
+	const unsigned int begin = idx;
+	unsigned int end = idx + 1;
+	while (end < expression.length() && (utils::isLetter(expression[end]) || utils::isDigit(expression[end]))) ++end;
+	idx = end - 1;
+	current = expression[begin]; // a letter, even when the name ends with digits, so that the next token sees a name
+	operator++();
+	return expression.substr(begin, end - begin);
+}
 
-// Parser
-/* Parser Language:
- * An operand (O) is an integer (int) or expression (E), possibly negated with a unary minus operator:
- * O := {-}int || {-}E
- *
- * A term (T) is a product/quotient of operands, or a single operand:
- * T := O { (* || /) O }
- *
- * An expression (E) is the sum/difference of terms, or a single term:
- * E := T { (+ || -) T }
- */
 
-std::unique_ptr<calc::classes::ASTNode> Calculator::parse(const std::string& expression) {
-	Lexer lex(expression);
-	return parseExpression(lex);
-};
+// Calculator
+Calculator::Calculator() = default;
+Calculator::~Calculator() = default;
+Calculator::Calculator(Calculator&&) noexcept = default;
+Calculator& Calculator::operator=(Calculator&&) noexcept = default;
+
+double Calculator::calculate(std::string_view expression) {
+	const calc::Result result = tryCalculate(expression);
+	if (!result) calc::utils::throwError(result.error);
+	return result.answer;
+}
 
-void Calculator::operateOnLeft(std::unique_ptr<ASTNode>& left, Lexer& lex) {
-	char op = *lex;
-	++lex;
-	std::unique_ptr<ASTNode> right;
-	switch (op) {
-	case '+':
-		right = parseTerm(lex);
-		left = std::make_unique<AddOrSubtract>(std::move(left), std::move(right));
-		break;
+calc::Result Calculator::tryCalculate(std::string_view expression) {
+	calc::Result result = cache ? cache->evaluate(expression, flatTree) : evaluate(expression, flatTree);
+	if (result) {
+		lastAnswer = result.answer;
+		lastExpression = expression;
+	}
+	return result;
+}
 
-	case '-':
-		right = parseTerm(lex);
-		left = std::make_unique<AddOrSubtract>(std::move(left), std::move(right), true);
-		break;
+std::vector<calc::Result> Calculator::calculateBatch(const std::vector<std::string_view>& expressions) {
+	std::vector<calc::Result> results(expressions.size());
+	for (std::size_t i = 0; i < expressions.size(); ++i)
+		results[i] = cache ? cache->evaluate(expressions[i], flatTree) : evaluate(expressions[i], flatTree);
+	return results;
+}
 
-	case '*':
-		right = parseOperand(lex);
-		left = std::make_unique<MultiplyOrDivide>(std::move(left), std::move(right));
-		break;
+void Calculator::enableCache(std::size_t capacity) {
+	if (capacity == 0) cache.reset();
+	else cache = std::make_unique<calc::ResultCache>(capacity);
+}
 
-	case '/':
-		right = parseOperand(lex);
-		left = std::make_unique<MultiplyOrDivide>(std::move(left), std::move(right), true);
-		break;
+void Calculator::enableSharing(bool isEnabled) {
+	flatTree.enableSharing(isEnabled);
+}
 
-	default: throw std::logic_error("Unexpected operator in operateOnLeft method");
+namespace {
+	calc::ErrorCode evaluateParsed(const calc::classes::FlatAST& tree, calc::classes::Number& answer,
+	                               unsigned int& errorOffset) {
+#if defined(CALC_ENGINE_PROGRAM)
+		if (!tree.isShared()) { // only shared when enabled by hand, and then left to the tree
+			thread_local calc::classes::Program program; // both reused by every evaluation of the calling thread
+			thread_local std::vector<calc::classes::Number> stack;
+			program.assign(tree);
+			return program.tryExecute(stack, answer, errorOffset);
+		}
+#endif
+		return tree.tryEvaluate(answer, errorOffset);
 	}
 }
 
-std::unique_ptr<calc::classes::ASTNode> Calculator::parseExpression(Lexer& lex) {
-	auto left = parseTerm(lex);
+calc::Result Calculator::evaluate(std::string_view expression, FlatAST& tree) {
+	using calc::stats::Phase;
+
+#if defined(CALC_ENGINE_SHARED)
+	if (!tree.isShared()) tree.enableSharing(true);
+#endif
+	calc::stats::PhaseTimer timer;
+	calc::Result result;
+	parse(expression, tree, result);
+	timer.lap(Phase::Parse);
+	if (result) {
+		Number answer;
+		result.error = evaluateParsed(tree, answer, result.offset);
+		if (result) result.answer = calc::utils::roundAnswer(answer);
+		timer.lap(Phase::Evaluate);
+	}
+	timer.total(Phase::Calculate);
+	calc::stats::flush();
+	return result;
+}
+
+const char* Calculator::getEngine() {
+#if defined(CALC_ENGINE_PROGRAM)
+	return "program";
+#elif defined(CALC_ENGINE_SHARED)
+	return "shared";
+#else
+	return "tree";
+#endif
+}
+
+calc::classes::Program Calculator::compile(std::string_view expression) {
+	const calc::stats::FlushOnExit flushOnExit;
+	FlatAST tree;
+	calc::Result result;
+	parse(expression, tree, result);
+	if (!result) calc::utils::throwError(result.error);
+	tree.simplify();
+	return Program(tree);
+}
+
+double Calculator::execute(const Program& program) {
+	const calc::stats::FlushOnExit flushOnExit;
+	return calc::utils::roundAnswer(program.execute(stack));
+}
+
+calc::Formula Calculator::compile(std::string_view expression, calc::VariableTable& variables) {
+	const calc::stats::FlushOnExit flushOnExit;
+	FlatAST tree;
+	calc::Result result;
+	parse(expression, tree, result, true);
+	if (!result) calc::utils::throwError(result.error);
+	return calc::Formula(std::move(tree), variables);
+}
+
+calc::ColumnarFormula Calculator::compileColumnar(std::string_view expression) {
+	const calc::stats::FlushOnExit flushOnExit;
+	FlatAST tree;
+	calc::Result result;
+	parse(expression, tree, result, true);
+	if (!result) calc::utils::throwError(result.error);
+	return calc::ColumnarFormula(std::move(tree));
+}
 
-	while (*lex == '+' || *lex == '-') // slight redundancy here, but this is otherwise the best way to do it
-		operateOnLeft(left, lex);
+#if defined(CALC_DECIMAL_BACKEND)
+calc::DecimalResult Calculator::tryCalculateDecimal(std::string_view expression) {
+	return evaluateDecimal(expression, decimalTree);
+}
 
-	return left;
+calc::DecimalResult Calculator::evaluateDecimal(std::string_view expression, calc::classes::DecimalAST& tree) {
+	const calc::stats::FlushOnExit flushOnExit;
+	calc::DecimalResult result;
+	tree.clear();
+	Lexer lex(expression);
+	parseExpression(lex, tree);
+	result.error = lex.getError();
+	result.offset = lex.getErrorOffset();
+	if (!result) return result;
+
+	calc::classes::Decimal answer;
+	result.error = tree.tryEvaluate(answer, result.offset);
+	if (result) result.answer = answer.rounded(calc::DECIMAL_DIGITS);
+	return result;
 }
+#endif
 
-std::unique_ptr<calc::classes::ASTNode> Calculator::parseTerm(Lexer& lex) {
-	auto left = parseOperand(lex);
 
-	while (*lex == '*' || *lex == '/')
-		operateOnLeft(left, lex);
+// Parser
+/* Parser Language:
+ * An operand (O) is an integer (int), variable (var) or expression (E), possibly negated with a unary minus operator:
+ * O := {-}int || {-}var || {-}E
+ *
+ * A term (T) is a product/quotient of operands, or a single operand:
+ * T := O { (* || /) O }
+ *
+ * An expression (E) is the sum/difference of terms, or a single term:
+ * E := T { (+ || -) T }
+ *
+ * Errors are recorded in the Lexer, which then returns Lexer::ERROR_CHAR until the end. This matches none of the
+ * tokens above, so the parser stops right away and the caller only has to check the Lexer once parsing is done.
+ */
 
-	return left;
+std::unique_ptr<calc::classes::ASTNode> Calculator::parse(std::string_view expression) {
+	Lexer lex(expression);
+	TreeBuilder builder;
+	auto tree = parseExpression(lex, builder);
+	if (lex.getError() != calc::ErrorCode::None) calc::utils::throwError(lex.getError());
+	return tree;
 };
 
-std::unique_ptr<calc::classes::ASTNode> Calculator::parseOperand(Lexer& lex) {
+void Calculator::parse(std::string_view expression, FlatAST& tree, calc::Result& result, bool allowVariables) {
+	tree.clear();
+	Lexer lex(expression, allowVariables);
+	parseExpression(lex, tree);
+	result.error = lex.getError();
+	result.offset = lex.getErrorOffset();
+	calc::stats::add(calc::stats::Counter::LexerTokens, lex.getNumTokens());
+	calc::stats::add(calc::stats::Counter::NodesCreated, tree.size());
+}
+
+template <typename Builder>
+typename Builder::Node Calculator::parseExpression(Lexer& lex, Builder& builder) {
 	using namespace calc::utils;
+	using Node = typename Builder::Node;
 
-	bool isNegative = false;
+	// the grammar above, with the recursion of O := {-}E unrolled: every open parenthesis pushes a frame, which holds
+	// the operators of its E and T still waiting for their right operand. Their left operands are on operands, in
+	// order, so the builder gets the same calls in the same order as it would from a recursive descent parser
+	thread_local std::vector<ParserFrame> frames;
+	thread_local std::vector<Node> operands;
+	frames.clear();
+	operands.clear();
+	frames.emplace_back();
 
 	while (true) {
-		if (*lex == '-') isNegative = !isNegative;
-		else if (*lex != '+') break;
-		++lex;
-	}
+		bool isNegative = false;
 
-	if (*lex == '(') {
-		++lex;
-		auto node = parseExpression(lex);
-		++lex;
-		if (isNegative) return std::make_unique<Negation>(std::move(node));
-		return node;
-	}
+		while (true) {
+			if (*lex == '-') isNegative = !isNegative;
+			else if (*lex != '+') break;
+			++lex;
+		}
 
-	double operand = 0;
-	while ( isDigit(*lex) ) {
-		operand *= 10;
-		operand += static_cast<double>(*lex) - static_cast<double>('0');
-		++lex;
-	}
+		if (*lex == '(') {
+			if (frames.size() <= calc::MAX_DEPTH) {
+				++lex;
+				frames.push_back({isNegative});
+				continue;
+			}
+			lex.fail(calc::ErrorCode::NestingTooDeep, lex.getPosition()); // the operand below is then an empty literal
+		}
 
-	if (operand == std::numeric_limits<double>::infinity() || !isBounded(operand))
-		throw std::overflow_error(overflowErrorMessage());
+		bool isVariable = false;
+		if constexpr (Builder::HAS_VARIABLES) {
+			if (isLetter(*lex)) { // only returned by Lexers that allow variables
+				const unsigned int position = lex.getPosition();
+				auto node = builder.variable(lex.name(), position);
+				if (isNegative) node = builder.negation(std::move(node));
+				operands.push_back(std::move(node));
+				isVariable = true;
+			}
+		}
+
+		if (!isVariable) {
+			const unsigned int position = lex.getPosition();
+			typename Builder::Literal literal;
+			while ( isDigit(*lex) ) // digits can be separated by spaces, so there may be more than one run of them
+				literal.append(lex.digits());
+
+			typename Builder::Value operand;
+			if (literal.toScientific(isNegative, operand) != calc::ErrorCode::None)
+				lex.fail(calc::ErrorCode::Overflow, position);
+			operands.push_back(builder.value(operand));
+		}
 
-	if (isNegative) operand = -operand;
-	return std::make_unique<ScientificValue>( makeScientific(operand) );
-};
\ No newline at end of file
+		// an operand completes the pending T, which may complete the pending E, which may complete the parentheses
+		// and so the operand of the frame below, and so on. Errors make the Lexer return ERROR_CHAR, which completes
+		// everything down to the first frame
+		while (true) {
+			ParserFrame& frame = frames.back();
+			if (frame.termOperator != '\0') {
+				Node right = std::move(operands.back());
+				operands.pop_back();
+				operands.back() = builder.multiplyOrDivide(std::move(operands.back()), std::move(right),
+				                                           frame.termOperator == '/', frame.termPosition);
+				frame.termOperator = '\0';
+			}
+			if (*lex == '*' || *lex == '/') {
+				frame.termOperator = *lex;
+				frame.termPosition = lex.getPosition();
+				++lex;
+				break;
+			}
+
+			if (frame.expressionOperator != '\0') {
+				Node right = std::move(operands.back());
+				operands.pop_back();
+				operands.back() = builder.addOrSubtract(std::move(operands.back()), std::move(right),
+				                                        frame.expressionOperator == '-', frame.expressionPosition);
+				frame.expressionOperator = '\0';
+			}
+			if (*lex == '+' || *lex == '-') {
+				frame.expressionOperator = *lex;
+				frame.expressionPosition = lex.getPosition();
+				++lex;
+				break;
+			}
+
+			if (frames.size() == 1) {
+				Node tree = std::move(operands.back());
+				operands.clear();
+				return tree;
+			}
+			++lex;
+			const bool isNegated = frame.isNegative;
+			frames.pop_back();
+			if (isNegated) operands.back() = builder.negation(std::move(operands.back()));
+		}
+	}
+}
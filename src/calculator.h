@@ -1,13 +1,19 @@
 #ifndef CALCULATOR_H
 #define CALCULATOR_H
 
+#include <array>
+#include <cstddef>
+#include <limits>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 
 
 /* Namespace Structure
  * namespace calc
  * ----constants
+ * ----results
  * ----namespace utils
  * ----namespace classes
  */
@@ -19,30 +25,159 @@ namespace calc {
     // for precision in double, MAX_DIGITS needs to be <= 14 . It is currently set to 12 to create a large safety
     // net against floating-point errors with double.
     inline constexpr unsigned int MAX_MAGNITUDE = 300; // double can store an exponent up to (plus-or-minus) 308
+#if defined(CALC_MAX_DEPTH)
+    inline constexpr unsigned int MAX_DEPTH = CALC_MAX_DEPTH;
+#else
+    inline constexpr unsigned int MAX_DEPTH = 1000;
+#endif
+    // most levels of nested parentheses the parser accepts. Set with the CALC_MAX_DEPTH cache variable in CMake
+#if defined(CALC_DECIMAL_BACKEND)
+    inline constexpr unsigned int DECIMAL_DIGITS = 36;
+    // precision of the decimal backend, which has no floating-point errors to guard against. Needs to be <= 36 so that
+    // literals can be rounded from a 128-bit integer
+#endif
+}
+
+
+// Results
+// for APIs that report errors as values instead of throwing them
+namespace calc {
+    enum class ErrorCode : unsigned char {
+        None,
+        // thrown as std::invalid_argument
+        EmptyExpression,
+        InvalidCharacter,
+        InvalidUnaryOperator, // unary * or /
+        AdjacentOperators,
+        LeadingOperator, // operator with no right operand, like in "3+5-"
+        UnmatchedOpenParenthesis,
+        UnmatchedClosedParenthesis,
+        EmptyParentheses,
+        NestingTooDeep, // more than MAX_DEPTH levels of parentheses
+        MissingOperator, // variable next to a literal, a parenthesis or another variable, like in "2x" or "x(y)"
+        UndefinedVariable,
+        // thrown as std::overflow_error
+        Overflow,
+        // thrown as std::domain_error
+        DivisionByZero
+    };
+
+    std::string errorMessage(ErrorCode error); // same message as the exception thrown for error
+
+    template <typename Answer>
+    struct BasicResult {
+        Answer answer{}; // only meaningful when error is None
+        ErrorCode error = ErrorCode::None;
+        unsigned int offset = 0; // index in the expression of the character where error was found
+
+        [[nodiscard]] constexpr bool hasValue() const { return error == ErrorCode::None; }
+        constexpr explicit operator bool() const { return hasValue(); }
+
+        [[nodiscard]] std::string message() const { return errorMessage(error); }
+    };
+
+    using Result = BasicResult<double>;
 }
 
 
 // Utilities
-namespace calc::classes { struct ScientificValue; } // forward-declaration
+namespace calc::classes { struct ScientificValue; struct Number; struct Decimal; } // forward-declaration
 namespace calc::utils {
 
     int getScientificMagnitude(double value);
+    // same as floor(log10(|value|)), which it still calls for subnormal values, and 0 for 0. Infinities and NaN give
+    // INT_MIN, what converting their floor(log10()) gives on x86, which no bound allows. Other values are compared
+    // against a table of the thresholds where std::log10() reaches each integer
+
+    double powerOfTen(int exponent); // same as std::pow(10, exponent), read from a table filled by std::pow
+
+    struct PowerTables { // behind the two functions above, also read directly by vectorized code
+        static inline constexpr int MIN_POWER = -400; // covers exponents of every normal double, with the extra digits
+        static inline constexpr int MAX_POWER = 400; // rounded by makeScientific()
+        static inline constexpr int MIN_THRESHOLD = -307; // 10 ^ -308 is subnormal, so it isn't needed
+        static inline constexpr int MAX_THRESHOLD = 308;
+
+        double powers[MAX_POWER - MIN_POWER + 1];
+        double thresholds[MAX_THRESHOLD - MIN_THRESHOLD + 1]; // smallest double x with floor(log10(x)) >= exponent
+
+        PowerTables();
+    };
+
+    const PowerTables& getPowerTables(); // filled at first use
 
     std::string overflowErrorMessage();
 
+    [[noreturn]] void throwError(ErrorCode error);
+
     bool isBounded(double value);
 
     bool isProductBounded(int magnitude1, int magnitude2);
 
-    bool isDigit(char c);
+    // character classes, looked up in a 256-entry table instead of searching through lists of characters
+    enum CharClass : unsigned char { OTHER = 0, DIGIT = 1, OPERATOR = 2, SPACE = 4, PARENTHESIS = 8, LETTER = 16 };
+
+    inline constexpr std::array<unsigned char, 256> CHAR_CLASSES = [] {
+        std::array<unsigned char, 256> classes{};
+        for (char c = '0'; c <= '9'; ++c) classes[static_cast<unsigned char>(c)] = DIGIT;
+        for (char c : {'+', '-', '*', '/'}) classes[static_cast<unsigned char>(c)] = OPERATOR;
+        classes[' '] = SPACE;
+        classes['('] = classes[')'] = PARENTHESIS;
+        for (char c = 'a'; c <= 'z'; ++c) classes[static_cast<unsigned char>(c)] = LETTER;
+        for (char c = 'A'; c <= 'Z'; ++c) classes[static_cast<unsigned char>(c)] = LETTER;
+        classes['_'] = LETTER;
+        return classes;
+    }();
 
-    bool isOperator(char c);
+    inline CharClass getCharClass(char c) {
+        return static_cast<CharClass>(CHAR_CLASSES[static_cast<unsigned char>(c)]);
+    }
+
+    inline bool isDigit(char c) { return getCharClass(c) == DIGIT; }
+
+    inline bool isOperator(char c) { return getCharClass(c) == OPERATOR; }
+
+    inline bool isLetter(char c) { return getCharClass(c) == LETTER; } // first character of a variable name
+
+    std::size_t skipDigits(std::string_view text, std::size_t pos);
+    // returns the index of the first non-digit in text at or after pos (or the length of text), checking 16
+    // characters at a time with SSE2 where available
+
+    std::size_t skipSpaces(std::string_view text, std::size_t pos); // same as skipDigits() for spaces
 
     classes::ScientificValue makeScientific(double value, unsigned int lastDigit = MAX_DIGITS + 1);
     // lastDigit represents digit that's been rounded, set to MAX_DIGITS + 1 by default. Then Calculator will
     // call makeScientific in last evaluation with lastDigit = MAX_DIGITS . This ensures that repeating values
     // will be properly rounded like 0.99999999... = 1
 
+    ErrorCode addOrSubtract(const classes::ScientificValue& left, const classes::ScientificValue& right, bool isSub,
+                            classes::ScientificValue& result);
+
+    ErrorCode multiplyOrDivide(const classes::ScientificValue& left, const classes::ScientificValue& right,
+                               bool isDiv, classes::ScientificValue& result);
+    // shared by every AST representation so that they all round and raise errors in exactly the same way. result is
+    // only set when no error is returned
+
+    ErrorCode addOrSubtract(const classes::Number& left, const classes::Number& right, bool isSub,
+                            classes::Number& result);
+
+    ErrorCode multiplyOrDivide(const classes::Number& left, const classes::Number& right, bool isDiv,
+                               classes::Number& result);
+    // exact + - and * when both operands are integers, computed in 128 bits when they overflow a long long so that
+    // they are only rounded once. Otherwise (and always for division) both operands are turned into ScientificValue
+    // for the functions above
+
+    double roundAnswer(const classes::Number& answer); // last rounding of an evaluation, to MAX_DIGITS digits
+
+#if defined(CALC_DECIMAL_BACKEND)
+    ErrorCode addOrSubtract(const classes::Decimal& left, const classes::Decimal& right, bool isSub,
+                            classes::Decimal& result);
+
+    ErrorCode multiplyOrDivide(const classes::Decimal& left, const classes::Decimal& right, bool isDiv,
+                               classes::Decimal& result);
+    // same operations on the decimal backend. Exact results are rounded to DECIMAL_DIGITS + 1 digits, and bounds and
+    // errors are the same as above
+#endif
+
 }
 
 
@@ -58,9 +193,10 @@ namespace calc::classes {
     };
 
     struct ScientificValue : public ASTNode {
-        double value;
-        int magnitude;
+        double value = 0;
+        int magnitude = 0;
 
+        ScientificValue() = default;
         ScientificValue(double val, int m);
 
         ScientificValue evaluate() override;
@@ -96,36 +232,393 @@ namespace calc::classes {
         ScientificValue evaluate() override;
     };
 
+    class Literal;
+    struct TreeBuilder { // lets the parser build the AST above
+        using Node = std::unique_ptr<ASTNode>;
+        using Value = ScientificValue; // number type of the values, read from literals by Literal
+        using Literal = classes::Literal;
+
+        static inline constexpr bool HAS_VARIABLES = false; // the parser only calls variable() on builders that have them
+
+        // position is the index of the operator in the expression, used to report errors
+        Node value(const ScientificValue& val);
+        Node negation(Node&& operand);
+        Node addOrSubtract(Node&& left, Node&& right, bool isSub, unsigned int position);
+        Node multiplyOrDivide(Node&& left, Node&& right, bool isDiv, unsigned int position);
+    };
+
+    // Number
+    // value of a subtree during evaluation. Integer-only subtrees are evaluated exactly in a long long with overflow-
+    // checked arithmetic, and only turn into a ScientificValue when an operation needs one. Integers are kept in
+    // [-LLONG_MAX, LLONG_MAX] so that negating one never overflows
+    struct Number {
+        long long integer = 0; // only used when isInteger
+        double value = 0; // value and magnitude are only used when not isInteger, like in ScientificValue
+        int magnitude = 0;
+        bool isInteger = false;
+
+        static inline constexpr long long MAX_INTEGER = std::numeric_limits<long long>::max();
+
+        Number() = default;
+        explicit Number(long long i): integer(i), isInteger(true) {}
+        explicit Number(const ScientificValue& val): value(val.value), magnitude(val.magnitude) {}
+
+        [[nodiscard]] ScientificValue toScientific() const; // an integer gives the same value as its literal would
+
+        [[nodiscard]] Number negated() const;
+    };
+
+    // Flat AST
+    // same tree as above, but all nodes are stored contiguously in one vector and point to their children by index.
+    // The parser appends children before their parent, so the root is always the last node. Clearing the tree keeps
+    // the vector's capacity, so reusing one FlatAST across expressions stops allocating once it has grown enough.
+    // Variables are leaves like values, but have no value of their own: see Formula in formula.h.
+    // With sharing enabled, a node identical to one already in the tree isn't appended again: the existing one is
+    // returned instead (hash-consing), so that a repeated subexpression is stored and evaluated only once. Nodes then
+    // form a DAG, still with children before their parents but no longer in post-order, which Program, Formula and
+    // ColumnarFormula rely on: they are always built from trees without sharing.
+    // Without sharing, an operation with a constant right operand is appended as a step of a Fold instead, and the
+    // steps that follow it are added to the same Fold: the terms of a long sum of literals take one node and one step
+    // each rather than two nodes, and are evaluated with one loop over the steps, still with the bounds checks of
+    // each partial result. simplify() expands folds back into operations, so that only parsed trees ever have them
+    enum class NodeType : unsigned char { Value, Negation, Add, Subtract, Multiply, Divide, Variable, Fold };
+
+    struct FlatNode {
+        NodeType type;
+        unsigned int left; // also the operand of Negation and Fold, and the index of the variable's name for Variable
+        unsigned int right; // for Fold, the index of its first step
+        unsigned int position; // index of the operator in the expression, or the number of steps of a Fold
+        Number constant; // only used by Value
+    };
+
+    struct FoldStep { // applies type to the value so far, as its left operand, and constant
+        NodeType type; // Add, Subtract, Multiply or Divide
+        unsigned int position;
+        Number constant;
+    };
+
+    class FlatAST {
+    public:
+        using Node = unsigned int; // index into nodes
+        using Value = Number;
+        using Literal = classes::Literal;
+
+        static inline constexpr bool HAS_VARIABLES = true;
+
+        void clear(); // keeps sharing enabled or not
+
+        void enableSharing(bool isEnabled); // also clears the tree
+        [[nodiscard]] bool isShared() const { return isSharing; }
+
+        [[nodiscard]] bool empty() const { return nodes.empty(); }
+        [[nodiscard]] std::size_t size() const { return nodes.size(); }
+        [[nodiscard]] Node root() const { return static_cast<Node>(nodes.size() - 1); }
+        [[nodiscard]] const FlatNode& operator[](Node n) const { return nodes[n]; }
+        [[nodiscard]] const FoldStep& step(std::size_t i) const { return steps[i]; } // of a Fold node
+        [[nodiscard]] const std::vector<std::string>& variableNames() const { return names; } // each name only once
+
+        Node value(const Number& val);
+        Node variable(std::string_view name, unsigned int position);
+        Node negation(Node operand);
+        Node addOrSubtract(Node left, Node right, bool isSub, unsigned int position);
+        Node multiplyOrDivide(Node left, Node right, bool isDiv, unsigned int position);
+
+        [[nodiscard]] Number evaluate() const;
+
+        ErrorCode tryEvaluate(Number& answer, unsigned int& errorOffset) const;
+        // same as evaluate() but returns errors instead of throwing them. answer or errorOffset is set accordingly.
+        // Variables have no value here, so they raise UndefinedVariable. Never recurses, however deep the tree is
+
+        void simplify();
+        // rewrites the tree into an equivalent one with fewer nodes: negation chains are collapsed or moved into the
+        // operations above them, folds are expanded, and operations on constants are folded. Rewrites are only made
+        // when they give the exact same answer and errors, so an operation whose folding fails stays in the tree for
+        // evaluate() to raise
+
+    private:
+
+        std::vector<FlatNode> nodes;
+        std::vector<FoldStep> steps; // of all the folds, each one's steps contiguous
+        std::vector<std::string> names; // of the variables, usually empty
+        std::vector<FlatNode> scratch; // scratch and remap are only used by simplify()
+        std::vector<Node> remap;
+
+        struct Slot {
+            Node node;
+            unsigned int generation; // the slot is empty unless it is the tree's current generation
+        };
+
+        bool isSharing = false;
+        std::vector<Slot> slots; // open addressing hash table of the nodes when sharing, its size a power of two
+        unsigned int generation = 1; // increased by clear(), which so empties every slot at once
+
+        Node append(NodeType type, Node left, Node right, unsigned int position);
+        Node appendOperation(NodeType type, Node left, Node right, unsigned int position); // into a Fold if it can
+        Node intern(); // returns the node identical to the last one, which is then removed if it isn't the only one
+        void rehash();
+
+        ErrorCode tryEvaluateShared(Number& answer, unsigned int& errorOffset) const;
+
+        Node simplifiedNegation(Node operand);
+        Node simplifiedOperation(NodeType type, Node left, Node right, unsigned int position);
+    };
+
+    // Program
+    // a FlatAST compiled into instructions for a stack machine. Push pushes its constant, Negate replaces the top
+    // value of the stack, and the other opcodes pop two values (left operand first) and push their result
+    enum class OpCode : unsigned char { Push, Negate, Add, Subtract, Multiply, Divide };
+
+    struct Instruction {
+        OpCode op;
+        Number constant; // only used by Push
+    };
+
+    class Program {
+    public:
+
+        Program() = default;
+
+        explicit Program(const FlatAST& tree) { assign(tree); } // tree can't have variables
+
+        void assign(const FlatAST& tree); // same as constructing from tree, but keeps the vectors' capacity
+
+        void clear() { code.clear(); positions.clear(); depth = 0; maxStackSize = 0; } // keeps the vectors' capacity
+
+        void append(const Instruction& instruction, unsigned int position);
+        // position is the index of the instruction's operator in the expression. The caller keeps the stack balanced:
+        // Negate and binary opcodes need one and two values on it
+
+        [[nodiscard]] const std::vector<Instruction>& instructions() const { return code; }
+        [[nodiscard]] unsigned int position(std::size_t i) const { return positions[i]; }
+        [[nodiscard]] std::size_t stackSize() const { return maxStackSize; }
+
+        Number execute(std::vector<Number>& stack) const;
+        // stack is scratch space, grown to stackSize() if needed so that it can be reused between calls
+
+        ErrorCode tryExecute(std::vector<Number>& stack, Number& answer, unsigned int& errorOffset) const;
+        // same as execute() but returns errors instead of throwing them
+
+    private:
+
+        std::vector<Instruction> code;
+        std::vector<unsigned int> positions; // position of each instruction's operator, only read to report errors
+        std::size_t depth = 0; // values on the stack after the last instruction
+        std::size_t maxStackSize = 0;
+    };
+
+    // Literal
+    // value of an integer literal, built from its runs of digits without going through inexact double arithmetic.
+    // Literals of up to MAX_EXACT_DIGITS significant digits are read into an integer, 8 digits at a time when
+    // possible. Longer ones are rounded straight to MAX_DIGITS + 1 digits from their decimal digits
+    class Literal {
+    public:
+
+        static inline constexpr unsigned int MAX_EXACT_DIGITS = 19; // any 19 digits fit in unsigned long long
+
+        void append(std::string_view digits);
+
+        ErrorCode toScientific(bool isNegative, ScientificValue& result) const;
+        // returns Overflow when the literal's magnitude is over MAX_MAGNITUDE
+
+        ErrorCode toScientific(bool isNegative, Number& result) const; // an integer when it is at most MAX_INTEGER
+
+    private:
+
+        unsigned long long leadingDigits = 0; // first MAX_EXACT_DIGITS significant digits
+        unsigned int numSignificantDigits = 0; // digits after the leading zeros
+    };
+
     // Lexer
     class Lexer {
     private:
 
         static inline constexpr char SENTINEL_CHAR = ' '; // unused sentinel value to silence warnings about uninitialized members
-        const std::string& expression;
+        std::string_view expression;
         unsigned int idx;
         unsigned int numOpenPars;
         bool isDelayed; // purpose is to return '*' in expressions like "...+4)7-..." before returning '7' here for example
         char current;
         char last;
         char delayed;
+        ErrorCode error;
+        unsigned int errorOffset;
+        bool isVariablesAllowed;
+        unsigned int numTokens;
 
     public:
 
-        explicit Lexer(const std::string& e);
+        static inline constexpr char ERROR_CHAR = '\0'; // returned after an error, so that the parser stops
+
+        explicit Lexer(std::string_view e, bool allowVariables = false);
+        // letters are invalid characters unless allowVariables. Then a letter or underscore starts a variable name,
+        // which goes on with letters, underscores and digits
 
         char operator*() const { return current; }
 
-        void operator++();
+        void operator++(); // does nothing after an error
+
+        std::string_view digits();
+        // returns the run of digits starting at the current token, which must be a digit, and moves to the token after
+        // it. Same as calling ++ once per digit, but the whole run is found at once
+
+        std::string_view name();
+        // returns the variable name starting at the current token, which must be a letter, and moves to the token after
+        // it. A name can't be directly next to a literal, a parenthesis or another name
+
+        void fail(ErrorCode e, unsigned int offset); // only the first error is kept
+
+        [[nodiscard]] ErrorCode getError() const { return error; }
+        [[nodiscard]] unsigned int getErrorOffset() const { return errorOffset; }
+        [[nodiscard]] unsigned int getPosition() const { return idx; } // index of the current token
+        [[nodiscard]] unsigned int getNumTokens() const { return numTokens; } // read so far, a run of digits counting once
+    };
+
+#if defined(CALC_DECIMAL_BACKEND)
+    // Decimal Backend
+    // only built with the CALC_DECIMAL_BACKEND option. A Decimal is a 128-bit integer coefficient times a power of ten,
+    // so every literal of up to DECIMAL_DIGITS + 1 digits is exact. The parser builds a DecimalAST with them the same
+    // way it builds a FlatAST, since both share the builder interface
+    struct Decimal {
+        unsigned __int128 coefficient = 0; // at most DECIMAL_DIGITS + 1 digits
+        int exponent = 0; // value is coefficient * 10 ^ exponent
+        bool isNegative = false;
+
+        [[nodiscard]] int magnitude() const; // same as getScientificMagnitude() for double, so 0 for 0
+
+        [[nodiscard]] Decimal rounded(unsigned int numDigits) const; // rounded half away from zero like round()
+
+        [[nodiscard]] std::string toString(unsigned int numDigits = DECIMAL_DIGITS) const;
+        // rounded to numDigits digits, then printed the way printf() prints a double with "%.*g"
+    };
+
+    class DecimalLiteral { // same as Literal, for the decimal backend
+    public:
+
+        static inline constexpr unsigned int MAX_EXACT_DIGITS = DECIMAL_DIGITS + 2; // enough to round the last digit
+
+        void append(std::string_view digits);
+
+        ErrorCode toScientific(bool isNegative, Decimal& result) const;
+        // rounds to DECIMAL_DIGITS + 1 digits. Returns Overflow when the literal's magnitude is over MAX_MAGNITUDE
+
+    private:
+
+        unsigned __int128 leadingDigits = 0;
+        unsigned int numSignificantDigits = 0;
     };
 
+    struct DecimalNode {
+        NodeType type;
+        unsigned int left;
+        unsigned int right;
+        unsigned int position;
+        Decimal value; // only used by Value
+    };
+
+    class DecimalAST { // same as FlatAST, with Decimal values
+    public:
+        using Node = unsigned int;
+        using Value = Decimal;
+        using Literal = DecimalLiteral;
+
+        static inline constexpr bool HAS_VARIABLES = false;
+
+        void clear() { nodes.clear(); }
+
+        [[nodiscard]] Node root() const { return static_cast<Node>(nodes.size() - 1); }
+
+        Node value(const Decimal& val);
+        Node negation(Node operand);
+        Node addOrSubtract(Node left, Node right, bool isSub, unsigned int position);
+        Node multiplyOrDivide(Node left, Node right, bool isDiv, unsigned int position);
+
+        ErrorCode tryEvaluate(Decimal& answer, unsigned int& errorOffset) const;
+
+    private:
+
+        std::vector<DecimalNode> nodes;
+
+        Node append(NodeType type, Node left, Node right, unsigned int position);
+    };
+#endif
+
 }
 
+#if defined(CALC_DECIMAL_BACKEND)
+namespace calc {
+    using DecimalResult = BasicResult<classes::Decimal>;
+}
+#endif
+
+
+namespace calc { class ResultCache; class VariableTable; class Formula; class ColumnarFormula; } // forward-declarations
+
 
 // Calculator
+// remembers the last expression and answer, so an instance can only be used by one thread at a time. Engine and Session
+// in engine.h split that history from the rest, so that one engine can be shared by every thread
 class Calculator {
 public:
 
-    double calculate(const std::string& expression);
+    Calculator();
+    ~Calculator();
+    Calculator(Calculator&&) noexcept;
+    Calculator& operator=(Calculator&&) noexcept;
+
+    double calculate(std::string_view expression);
+
+    calc::Result tryCalculate(std::string_view expression);
+    // same as calculate() but never throws for an invalid expression: the error and where it was found are returned
+    // instead. Last expression and answer are only updated on success
+
+    static calc::classes::Program compile(std::string_view expression);
+    // throws the same errors as calculate() for invalid expressions. Errors during evaluation (overflow, division by
+    // zero) are only raised by execute()
+
+    double execute(const calc::classes::Program& program);
+    // returns the same answer as calculate() on the compiled expression, without updating last expression or answer
+
+    static calc::Formula compile(std::string_view expression, calc::VariableTable& variables);
+    // compiles an expression that can use the variables of the table, see Formula. Throws like compile() above
+
+    static calc::ColumnarFormula compileColumnar(std::string_view expression);
+    // same, for evaluating the expression over columns of inputs, see ColumnarFormula
+
+    std::vector<calc::Result> calculateBatch(const std::vector<std::string_view>& expressions);
+    // results are in the same order as expressions. An invalid expression only sets the error of its own result, and
+    // last expression and answer are not updated
+
+    static calc::Result evaluate(std::string_view expression, calc::classes::FlatAST& tree);
+    // stateless version of tryCalculate(), safe to call from several threads as long as each one has its own tree.
+    // Evaluates with the engine picked at build time, see getEngine()
+
+    [[nodiscard]] static const char* getEngine();
+    // "tree", "program" or "shared", set with the CALC_ENGINE cache variable in CMake. tree evaluates the parsed tree
+    // in one pass, program compiles it into a Program first, and shared enables sharing in every tree it parses
+
+    static void parse(std::string_view expression, calc::classes::FlatAST& tree, calc::Result& result,
+                      bool allowVariables = false);
+    // first half of evaluate(): clears tree before parsing into it. Sets the error and offset of result if expression
+    // is invalid
+
+#if defined(CALC_DECIMAL_BACKEND)
+    calc::DecimalResult tryCalculateDecimal(std::string_view expression);
+    // same as tryCalculate() on the decimal backend, so the answer has DECIMAL_DIGITS digits. Last expression and
+    // answer are not updated
+
+    static calc::DecimalResult evaluateDecimal(std::string_view expression, calc::classes::DecimalAST& tree);
+#endif
+
+    void enableCache(std::size_t capacity);
+    // from then on, calculate(), tryCalculate() and calculateBatch() remember the results of the capacity most
+    // recently used expressions, including errors. A capacity of 0 disables the cache again
+
+    [[nodiscard]] const calc::ResultCache* getCache() const { return cache.get(); } // nullptr when disabled
+
+    void enableSharing(bool isEnabled);
+    // from then on, calculate(), tryCalculate() and calculateBatch() store and evaluate each repeated subexpression
+    // only once, see FlatAST. Results, errors and offsets stay the same, but hashing every node makes parsing slower,
+    // so it only pays off on expressions that repeat themselves, like generated ones
 
     std::string getLastExpression() const { return lastExpression; }
     double getLastAnswer() const { return lastAnswer; }
@@ -134,21 +627,31 @@ private:
 
     using ASTNode = calc::classes::ASTNode;
     using ScientificValue = calc::classes::ScientificValue;
+    using Number = calc::classes::Number;
     using Negation = calc::classes::Negation;
     using AddOrSubtract = calc::classes::AddOrSubtract;
     using MultiplyOrDivide = calc::classes::MultiplyOrDivide;
     using Lexer = calc::classes::Lexer;
+    using TreeBuilder = calc::classes::TreeBuilder;
+    using FlatAST = calc::classes::FlatAST;
+    using Program = calc::classes::Program;
 
 
     // Data Members
     std::string lastExpression = "0";
     double lastAnswer = 0;
+    FlatAST flatTree; // reused by every call to calculate()
+    std::vector<Number> stack; // reused by every call to execute()
+    std::unique_ptr<calc::ResultCache> cache;
+#if defined(CALC_DECIMAL_BACKEND)
+    calc::classes::DecimalAST decimalTree; // reused by every call to tryCalculateDecimal()
+#endif
 
 
     // Parser
     /* Parser Language:
-     * An operand (O) is an integer (int) or expression (E), possibly negated with a unary minus operator:
-     * O := {-}int || {-}E
+     * An operand (O) is an integer (int), variable (var) or expression (E), possibly negated with a unary minus operator:
+     * O := {-}int || {-}var || {-}E
      *
      * A term (T) is a product/quotient of operands, or a single operand:
      * T := O { (* || /) O }
@@ -157,15 +660,23 @@ private:
      * E := T { (+ || -) T }
      */
 
-    static std::unique_ptr<ASTNode> parse(const std::string& expression);
-
-    static void operateOnLeft(std::unique_ptr<ASTNode>& left, Lexer& lex);
+    static std::unique_ptr<ASTNode> parse(std::string_view expression);
 
-    static std::unique_ptr<ASTNode> parseExpression(Lexer& lex);
-
-    static std::unique_ptr<ASTNode> parseTerm(Lexer& lex);
+    struct ParserFrame { // one per open parenthesis, see parseExpression()
+        bool isNegative = false; // of the operand the parentheses make
+        char expressionOperator = '\0'; // + or - waiting for its right operand, if any
+        unsigned int expressionPosition = 0;
+        char termOperator = '\0'; // * or / waiting for its right operand, if any
+        unsigned int termPosition = 0;
+    };
 
-    static std::unique_ptr<ASTNode> parseOperand(Lexer& lex);
+    // Builder is TreeBuilder, FlatAST or DecimalAST, which all create nodes through the same member functions. Its Value
+    // is the number type of the backend, and its Literal reads literals into it. Only builders with HAS_VARIABLES
+    // have variable()
+    template <typename Builder>
+    static typename Builder::Node parseExpression(Lexer& lex, Builder& builder);
+    // doesn't recurse: nested parentheses take frames on an explicit stack, which every thread reuses from one parse
+    // to the next. Fails with NestingTooDeep at the parenthesis opening level MAX_DEPTH + 1
 
 };
 
@@ -0,0 +1,506 @@
+#include "columnar.h"
+#include "formula.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+
+// Lanes
+// the few operations the kernels need, on WIDTH doubles at a time. Masks are what comparisons return, and are stored
+// in blocks as doubles. Every operation is a single instruction, so the kernels below round exactly like the scalar
+// code they replace
+namespace {
+#if defined(__AVX2__)
+	constexpr unsigned int WIDTH = 4;
+	constexpr const char* INSTRUCTION_SET = "AVX2";
+	using Vec = __m256d;
+	using Mask = __m256d;
+
+	inline Vec load(const double* p) { return _mm256_load_pd(p); }
+	inline void store(double* p, Vec v) { _mm256_store_pd(p, v); }
+	inline Vec broadcast(double x) { return _mm256_set1_pd(x); }
+	inline Vec add(Vec a, Vec b) { return _mm256_add_pd(a, b); }
+	inline Vec sub(Vec a, Vec b) { return _mm256_sub_pd(a, b); }
+	inline Vec mul(Vec a, Vec b) { return _mm256_mul_pd(a, b); }
+	inline Vec div(Vec a, Vec b) { return _mm256_div_pd(a, b); }
+	inline Vec negate(Vec a) { return _mm256_xor_pd(a, _mm256_set1_pd(-0.0)); }
+	inline Vec absolute(Vec a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+	inline Vec truncate(Vec a) { return _mm256_round_pd(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+	inline Vec roundDown(Vec a) { return _mm256_round_pd(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+	inline Mask less(Vec a, Vec b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+	inline Mask lessOrEqual(Vec a, Vec b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+	inline Mask equal(Vec a, Vec b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+	inline Mask both(Mask a, Mask b) { return _mm256_and_pd(a, b); }
+	inline Mask either(Mask a, Mask b) { return _mm256_or_pd(a, b); }
+	inline Mask butNot(Mask a, Mask b) { return _mm256_andnot_pd(b, a); }
+	inline Vec select(Mask m, Vec a, Vec b) { return _mm256_blendv_pd(b, a, m); }
+	inline unsigned int lanes(Mask m) { return static_cast<unsigned int>(_mm256_movemask_pd(m)); }
+	inline Mask loadMask(const double* p) { return _mm256_load_pd(p); }
+	inline void storeMask(double* p, Mask m) { _mm256_store_pd(p, m); }
+
+	inline Vec biasedExponent(Vec x) { // bits 52 to 62, which are bits 20 to 30 of the high half of each lane
+		const __m256i high = _mm256_permutevar8x32_epi32(_mm256_castpd_si256(x), _mm256_setr_epi32(1, 3, 5, 7, 1, 3, 5, 7));
+		const __m128i exponent = _mm_and_si128(_mm_srli_epi32(_mm256_castsi256_si128(high), 20), _mm_set1_epi32(0x7FF));
+		return _mm256_cvtepi32_pd(exponent);
+	}
+
+	inline Vec lookup(const double* table, Vec index) { // four loads beat _mm256_i32gather_pd() on most CPUs
+		alignas(16) int indexes[WIDTH];
+		_mm_store_si128(reinterpret_cast<__m128i*>(indexes), _mm256_cvtpd_epi32(index));
+		return _mm256_setr_pd(table[indexes[0]], table[indexes[1]], table[indexes[2]], table[indexes[3]]);
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	constexpr unsigned int WIDTH = 2;
+	constexpr const char* INSTRUCTION_SET = "NEON";
+	using Vec = float64x2_t;
+	using Mask = uint64x2_t;
+
+	inline Vec load(const double* p) { return vld1q_f64(p); }
+	inline void store(double* p, Vec v) { vst1q_f64(p, v); }
+	inline Vec broadcast(double x) { return vdupq_n_f64(x); }
+	inline Vec add(Vec a, Vec b) { return vaddq_f64(a, b); }
+	inline Vec sub(Vec a, Vec b) { return vsubq_f64(a, b); }
+	inline Vec mul(Vec a, Vec b) { return vmulq_f64(a, b); }
+	inline Vec div(Vec a, Vec b) { return vdivq_f64(a, b); }
+	inline Vec negate(Vec a) { return vnegq_f64(a); }
+	inline Vec absolute(Vec a) { return vabsq_f64(a); }
+	inline Vec truncate(Vec a) { return vrndq_f64(a); }
+	inline Vec roundDown(Vec a) { return vrndmq_f64(a); }
+	inline Mask less(Vec a, Vec b) { return vcltq_f64(a, b); }
+	inline Mask lessOrEqual(Vec a, Vec b) { return vcleq_f64(a, b); }
+	inline Mask equal(Vec a, Vec b) { return vceqq_f64(a, b); }
+	inline Mask both(Mask a, Mask b) { return vandq_u64(a, b); }
+	inline Mask either(Mask a, Mask b) { return vorrq_u64(a, b); }
+	inline Mask butNot(Mask a, Mask b) { return vbicq_u64(a, b); }
+	inline Vec select(Mask m, Vec a, Vec b) { return vbslq_f64(m, a, b); }
+	inline unsigned int lanes(Mask m) {
+		return static_cast<unsigned int>((vgetq_lane_u64(m, 0) & 1) | (vgetq_lane_u64(m, 1) & 1) << 1);
+	}
+	inline Mask loadMask(const double* p) { return vreinterpretq_u64_f64(vld1q_f64(p)); }
+	inline void storeMask(double* p, Mask m) { vst1q_f64(p, vreinterpretq_f64_u64(m)); }
+
+	inline Vec biasedExponent(Vec x) {
+		return vcvtq_f64_u64(vandq_u64(vshrq_n_u64(vreinterpretq_u64_f64(x), 52), vdupq_n_u64(0x7FF)));
+	}
+
+	inline Vec lookup(const double* table, Vec index) { // NEON has no gather
+		const double values[WIDTH] = {table[static_cast<int>(vgetq_lane_f64(index, 0))],
+		                              table[static_cast<int>(vgetq_lane_f64(index, 1))]};
+		return vld1q_f64(values);
+	}
+#else
+	constexpr unsigned int WIDTH = 1;
+	constexpr const char* INSTRUCTION_SET = "scalar";
+	using Vec = double;
+	using Mask = bool;
+
+	inline Vec load(const double* p) { return *p; }
+	inline void store(double* p, Vec v) { *p = v; }
+	inline Vec broadcast(double x) { return x; }
+	inline Vec add(Vec a, Vec b) { return a + b; }
+	inline Vec sub(Vec a, Vec b) { return a - b; }
+	inline Vec mul(Vec a, Vec b) { return a * b; }
+	inline Vec div(Vec a, Vec b) { return a / b; }
+	inline Vec negate(Vec a) { return -a; }
+	inline Vec absolute(Vec a) { return std::abs(a); }
+	inline Vec truncate(Vec a) { return std::trunc(a); }
+	inline Vec roundDown(Vec a) { return std::floor(a); }
+	inline Mask less(Vec a, Vec b) { return a < b; }
+	inline Mask lessOrEqual(Vec a, Vec b) { return a <= b; }
+	inline Mask equal(Vec a, Vec b) { return a == b; }
+	inline Mask both(Mask a, Mask b) { return a && b; }
+	inline Mask either(Mask a, Mask b) { return a || b; }
+	inline Mask butNot(Mask a, Mask b) { return a && !b; }
+	inline Vec select(Mask m, Vec a, Vec b) { return m ? a : b; }
+	inline unsigned int lanes(Mask m) { return m ? 1 : 0; }
+	inline Mask loadMask(const double* p) { return *p != 0.0; }
+	inline void storeMask(double* p, Mask m) { *p = m ? 1.0 : 0.0; }
+
+	inline Vec biasedExponent(Vec x) {
+		std::uint64_t bits;
+		std::memcpy(&bits, &x, sizeof(bits));
+		return static_cast<double>((bits >> 52) & 0x7FF);
+	}
+
+	inline Vec lookup(const double* table, Vec index) { return table[static_cast<int>(index)]; }
+#endif
+
+	constexpr unsigned int ALL_LANES = (1u << WIDTH) - 1;
+	static_assert(calc::ColumnarFormula::BLOCK_SIZE % WIDTH == 0, "blocks must hold a whole number of vectors");
+
+	inline Mask fromLanes(unsigned int bits) {
+		alignas(32) double values[WIDTH];
+		for (unsigned int i = 0; i < WIDTH; ++i) values[i] = (bits >> i & 1) != 0 ? 1.0 : 0.0;
+		return equal(load(values), broadcast(1.0));
+	}
+
+
+	// Kernels
+	// on WIDTH rows at a time, with the same results as the functions of calc::utils on each row. Lanes that are
+	// subnormal, infinite or NaN go through those functions one at a time: they never show up in rows without errors,
+	// except for the odd subnormal sum or difference
+	using calc::utils::PowerTables;
+
+	constexpr double MAX_EXACT_INTEGER = calc::VariableTable::MAX_EXACT_INTEGER;
+
+	struct Scientific {
+		Vec value;
+		Vec magnitude;
+	};
+
+	struct Lanes { // one vector of a Block
+		Vec value;
+		Vec magnitude;
+		Mask isInteger;
+	};
+
+	inline Mask isSpecial(Vec x, Vec exponent) {
+		return either(equal(exponent, broadcast(0x7FF)), butNot(equal(exponent, broadcast(0)), equal(x, broadcast(0))));
+	}
+
+	// index into a table of size values, which lanes of rows that already failed can have anywhere, even NaN: they
+	// are clamped so that lookups stay in the table. Their values are never read, and other lanes are already in it
+	inline Vec clampIndex(Vec index, int size) {
+		const Vec last = broadcast(size - 1);
+		return select(lessOrEqual(index, last), select(lessOrEqual(broadcast(0), index), index, broadcast(0)), last);
+	}
+
+	inline Vec magnitudeOf(Vec x, Vec exponent) {
+		// same steps as getScientificMagnitude(), on lanes that aren't special. 0 gives garbage
+		constexpr int SIZE = PowerTables::MAX_THRESHOLD - PowerTables::MIN_THRESHOLD + 1;
+		const Vec candidate = roundDown(mul(sub(exponent, broadcast(1023)), broadcast(78913.0 / 262144.0)));
+		const Vec index = clampIndex(add(candidate, broadcast(1 - PowerTables::MIN_THRESHOLD)), SIZE);
+		const Mask isAbove = lessOrEqual(lookup(calc::utils::getPowerTables().thresholds, index), absolute(x));
+		return add(candidate, select(isAbove, broadcast(1), broadcast(0)));
+	}
+
+	inline Vec rawValue(const Scientific& s) {
+		constexpr int SIZE = PowerTables::MAX_POWER - PowerTables::MIN_POWER + 1;
+		const Vec index = clampIndex(sub(s.magnitude, broadcast(PowerTables::MIN_POWER)), SIZE);
+		return mul(s.value, lookup(calc::utils::getPowerTables().powers, index));
+	}
+
+	Scientific makeScientificByLane(Vec x, unsigned int lastDigit) {
+		alignas(32) double values[WIDTH];
+		alignas(32) double magnitudes[WIDTH];
+		store(values, x);
+		for (unsigned int i = 0; i < WIDTH; ++i) {
+			magnitudes[i] = 0;
+			if (!std::isfinite(values[i])) continue; // only in rows with errors, where values are never read
+			const calc::classes::ScientificValue scientific = calc::utils::makeScientific(values[i], lastDigit);
+			values[i] = scientific.value;
+			magnitudes[i] = scientific.magnitude;
+		}
+		return {load(values), load(magnitudes)};
+	}
+
+	Scientific makeScientific(Vec x, unsigned int lastDigit = calc::MAX_DIGITS + 1) {
+		const Vec exponent = biasedExponent(x);
+		if (lanes(isSpecial(x, exponent)) != 0) return makeScientificByLane(x, lastDigit);
+
+		const PowerTables& tables = calc::utils::getPowerTables();
+		const Vec magnitude = magnitudeOf(x, exponent);
+		const Vec power = lookup(tables.powers, sub(broadcast(lastDigit - 1 - PowerTables::MIN_POWER), magnitude));
+		const Vec scaled = mul(x, power);
+		// std::round(), which rounds halves away from zero. The fraction of scaled is exact
+		const Vec truncated = truncate(scaled);
+		const Mask isRoundedUp = lessOrEqual(broadcast(0.5), absolute(sub(scaled, truncated)));
+		const Vec away = select(less(scaled, broadcast(0)), broadcast(-1), broadcast(1));
+		const Vec rounded = select(isRoundedUp, add(truncated, away), truncated);
+		const Vec value = div(div(rounded, power), lookup(tables.powers, sub(magnitude, broadcast(PowerTables::MIN_POWER))));
+
+		const Mask isZero = equal(x, broadcast(0));
+		return {select(isZero, broadcast(0), value), select(isZero, broadcast(0), magnitude)};
+	}
+
+	Mask isBounded(Vec x) {
+		const Vec exponent = biasedExponent(x);
+		if (lanes(isSpecial(x, exponent)) != 0) {
+			alignas(32) double values[WIDTH];
+			store(values, x);
+			unsigned int bits = 0;
+			for (unsigned int i = 0; i < WIDTH; ++i)
+				if (std::isfinite(values[i]) && calc::utils::isBounded(values[i])) bits |= 1u << i;
+			return fromLanes(bits);
+		}
+		const Vec magnitude = select(equal(x, broadcast(0)), broadcast(0), magnitudeOf(x, exponent));
+		return lessOrEqual(absolute(magnitude), broadcast(calc::MAX_MAGNITUDE));
+	}
+
+	inline Mask isMagnitudeBounded(Vec magnitude) { // same as isProductBounded() on the sum of two magnitudes
+		return lessOrEqual(absolute(magnitude), broadcast(calc::MAX_MAGNITUDE));
+	}
+
+	Scientific toScientific(const Lanes& x) { // same as Number::toScientific()
+		if (lanes(x.isInteger) == 0) return {x.value, x.magnitude};
+		const Scientific integer = makeScientific(x.value);
+		return {select(x.isInteger, integer.value, x.value), select(x.isInteger, integer.magnitude, x.magnitude)};
+	}
+
+	// integers below 2 ^ 53 are exact in a double, and so are their sums and products as long as they stay below it.
+	// Lanes where they don't are returned in inexact, to be evaluated again in a long long
+	Lanes addOrSubtract(const Lanes& left, const Lanes& right, bool isSub, unsigned int& overflows, unsigned int& inexact) {
+		const Mask isInteger = both(left.isInteger, right.isInteger);
+		const Vec integer = isSub ? sub(left.value, right.value) : add(left.value, right.value);
+		inexact = lanes(both(isInteger, lessOrEqual(broadcast(MAX_EXACT_INTEGER), absolute(integer))));
+		overflows = 0;
+		if (lanes(isInteger) == ALL_LANES) return {integer, broadcast(0), isInteger};
+
+		const Vec leftRaw = rawValue(toScientific(left));
+		const Vec rightRaw = rawValue(toScientific(right));
+		const Vec sum = isSub ? sub(leftRaw, rightRaw) : add(leftRaw, rightRaw);
+		overflows = ALL_LANES & ~lanes(either(isInteger, isBounded(sum)));
+		const Scientific scientific = makeScientific(sum);
+		return {select(isInteger, integer, scientific.value), select(isInteger, broadcast(0), scientific.magnitude),
+		        isInteger};
+	}
+
+	Lanes multiply(const Lanes& left, const Lanes& right, unsigned int& overflows, unsigned int& inexact) {
+		const Mask isInteger = both(left.isInteger, right.isInteger);
+		const Vec integer = mul(left.value, right.value);
+		inexact = lanes(both(isInteger, lessOrEqual(broadcast(MAX_EXACT_INTEGER), absolute(integer))));
+		overflows = 0;
+		if (lanes(isInteger) == ALL_LANES) return {integer, broadcast(0), isInteger};
+
+		const Scientific leftScientific = toScientific(left);
+		const Scientific rightScientific = toScientific(right);
+		overflows = ALL_LANES & ~lanes(either(isInteger,
+			isMagnitudeBounded(add(leftScientific.magnitude, rightScientific.magnitude))));
+		const Scientific scientific = makeScientific(mul(rawValue(leftScientific), rawValue(rightScientific)));
+		return {select(isInteger, integer, scientific.value), select(isInteger, broadcast(0), scientific.magnitude),
+		        isInteger};
+	}
+
+	Lanes divide(const Lanes& left, const Lanes& right, unsigned int& overflows, unsigned int& divisionsByZero) {
+		const Scientific leftScientific = toScientific(left);
+		const Scientific rightScientific = toScientific(right);
+		const Mask isZero = equal(rightScientific.value, broadcast(0));
+		divisionsByZero = lanes(isZero);
+		overflows = ALL_LANES & ~lanes(either(isZero,
+			isMagnitudeBounded(sub(leftScientific.magnitude, rightScientific.magnitude))));
+		const Scientific scientific = makeScientific(div(rawValue(leftScientific), rawValue(rightScientific)));
+		return {scientific.value, scientific.magnitude, less(broadcast(0), broadcast(0))};
+	}
+}
+
+
+// Columnar Formula
+calc::ColumnarFormula::ColumnarFormula(classes::FlatAST&& t): tree(std::move(t)) {
+	using classes::NodeType;
+
+	tree.simplify();
+	std::size_t stackSize = 0;
+	std::size_t maxStackSize = 0;
+	for (classes::FlatAST::Node n = 0; n < tree.size(); ++n) {
+		switch (tree[n].type) {
+		case NodeType::Value:
+		case NodeType::Variable: maxStackSize = std::max(maxStackSize, ++stackSize); break;
+		case NodeType::Negation: break;
+		default: --stackSize; // binary operations pop two values and push one
+		}
+	}
+	stack.resize(maxStackSize);
+	operands.resize(maxStackSize);
+	scalarStack.resize(maxStackSize);
+	inputs.resize(tree.variableNames().size());
+	outOfBounds.resize(tree.variableNames().size() * BLOCK_SIZE);
+}
+
+const char* calc::ColumnarFormula::getInstructionSet() {
+	return INSTRUCTION_SET;
+}
+
+void calc::ColumnarFormula::evaluate(const std::vector<const double*>& columns, std::size_t numRows, Result* results) {
+	const stats::FlushOnExit flushOnExit;
+	if (columns.size() != inputs.size())
+		throw std::invalid_argument("Expected one column per variable in ColumnarFormula::evaluate method");
+
+	numScalarRows = 0;
+	for (std::size_t begin = 0; begin < numRows; begin += BLOCK_SIZE)
+		evaluateBlock(columns, begin, std::min(BLOCK_SIZE, numRows - begin), results + begin);
+}
+
+void calc::ColumnarFormula::evaluateBlock(
+	const std::vector<const double*>& columns, std::size_t begin, std::size_t numRows, Result* results) {
+	using classes::NodeType;
+
+	const std::size_t numLanes = (numRows + WIDTH - 1) / WIDTH * WIDTH; // rows past numRows are padding
+	std::fill(errors, errors + BLOCK_SIZE, ErrorCode::None);
+	std::fill(isScalar, isScalar + BLOCK_SIZE, false);
+
+	// inputs are converted like VariableTable::toNumber(), once per block however many times they are used
+	for (std::size_t c = 0; c < columns.size(); ++c) {
+		Block& input = inputs[c];
+		std::copy(columns[c] + begin, columns[c] + begin + numRows, input.value);
+		std::fill(input.value + numRows, input.value + numLanes, 0.0);
+		for (std::size_t i = 0; i < numLanes; i += WIDTH) {
+			const Vec x = load(input.value + i);
+			const Mask isInteger = both(lessOrEqual(absolute(x), broadcast(MAX_EXACT_INTEGER)), equal(truncate(x), x));
+			Scientific scientific = {x, broadcast(0)};
+			Mask isInBounds = isInteger;
+			if (lanes(isInteger) != ALL_LANES) {
+				scientific = makeScientific(x);
+				isInBounds = either(isInteger, isBounded(x));
+			}
+			store(input.value + i, select(isInteger, x, scientific.value));
+			store(input.magnitude + i, select(isInteger, broadcast(0), scientific.magnitude));
+			storeMask(input.isInteger + i, isInteger);
+			outOfBounds[c * BLOCK_SIZE + i] = ALL_LANES & ~lanes(isInBounds);
+		}
+	}
+
+	// nodes are in post-order, so they are evaluated like a Program, with one block per value on the stack. Operations
+	// write their result over their left operand, vector by vector, after reading both operands
+	std::size_t top = 0;
+	for (classes::FlatAST::Node n = 0; n < tree.size(); ++n) {
+		const classes::FlatNode& node = tree[n];
+		switch (node.type) {
+		case NodeType::Value: {
+			Block& block = stack[top];
+			const classes::Number& constant = node.constant;
+			if (constant.isInteger && std::abs(static_cast<double>(constant.integer)) >= MAX_EXACT_INTEGER)
+				std::fill(isScalar, isScalar + numRows, true);
+			const Vec value = broadcast(constant.isInteger ? static_cast<double>(constant.integer) : constant.value);
+			const Vec magnitude = broadcast(constant.isInteger ? 0 : constant.magnitude);
+			const Mask isInteger = constant.isInteger ? equal(value, value) : less(value, value);
+			for (std::size_t i = 0; i < numLanes; i += WIDTH) {
+				store(block.value + i, value);
+				store(block.magnitude + i, magnitude);
+				storeMask(block.isInteger + i, isInteger);
+			}
+			operands[top++] = &block;
+			break;
+		}
+
+		case NodeType::Variable:
+			for (std::size_t i = 0; i < numLanes; i += WIDTH)
+				fail(outOfBounds[node.left * BLOCK_SIZE + i], i, ErrorCode::Overflow, node.position);
+			operands[top++] = &inputs[node.left];
+			break;
+
+		case NodeType::Negation: {
+			const Block& operand = *operands[top - 1];
+			Block& result = stack[top - 1];
+			for (std::size_t i = 0; i < numLanes; i += WIDTH) {
+				store(result.value + i, negate(load(operand.value + i)));
+				store(result.magnitude + i, load(operand.magnitude + i));
+				storeMask(result.isInteger + i, loadMask(operand.isInteger + i));
+			}
+			operands[top - 1] = &result;
+			break;
+		}
+
+		default: {
+			const Block& left = *operands[top - 2];
+			const Block& right = *operands[top - 1];
+			Block& result = stack[top - 2];
+			for (std::size_t i = 0; i < numLanes; i += WIDTH) {
+				const Lanes leftLanes = {load(left.value + i), load(left.magnitude + i), loadMask(left.isInteger + i)};
+				const Lanes rightLanes = {load(right.value + i), load(right.magnitude + i), loadMask(right.isInteger + i)};
+				unsigned int overflows = 0;
+				unsigned int others = 0; // inexact integers, or divisions by zero
+				Lanes out;
+				switch (node.type) {
+				case NodeType::Add: out = addOrSubtract(leftLanes, rightLanes, false, overflows, others); break;
+				case NodeType::Subtract: out = addOrSubtract(leftLanes, rightLanes, true, overflows, others); break;
+				case NodeType::Multiply: out = multiply(leftLanes, rightLanes, overflows, others); break;
+				case NodeType::Divide: out = divide(leftLanes, rightLanes, overflows, others); break;
+				default: throw std::logic_error("Unexpected node type in ColumnarFormula::evaluateBlock method");
+				}
+				store(result.value + i, out.value);
+				store(result.magnitude + i, out.magnitude);
+				storeMask(result.isInteger + i, out.isInteger);
+
+				if (node.type == NodeType::Divide) fail(others, i, ErrorCode::DivisionByZero, node.position);
+				else for (; others != 0; others &= others - 1) isScalar[i + __builtin_ctz(others)] = true;
+				fail(overflows, i, ErrorCode::Overflow, node.position);
+			}
+			--top;
+			operands[top - 1] = &result;
+		}
+		}
+	}
+
+	// the last rounding of roundAnswer()
+	const Block& answer = *operands[0];
+	for (std::size_t i = 0; i < numLanes; i += WIDTH) {
+		const Scientific scientific = {load(answer.value + i), load(answer.magnitude + i)};
+		const Vec value = select(loadMask(answer.isInteger + i), scientific.value, rawValue(scientific));
+		store(answers + i, rawValue(makeScientific(value, MAX_DIGITS)));
+	}
+
+	for (std::size_t row = 0; row < numRows; ++row) {
+		if (isScalar[row]) {
+			results[row] = evaluateRow(columns, begin + row);
+			++numScalarRows;
+			continue;
+		}
+		results[row].error = errors[row];
+		results[row].offset = errors[row] == ErrorCode::None ? 0 : errorOffsets[row];
+		results[row].answer = errors[row] == ErrorCode::None ? answers[row] : 0;
+	}
+}
+
+void calc::ColumnarFormula::fail(unsigned int lanes, std::size_t first, ErrorCode error, unsigned int offset) {
+	for (; lanes != 0; lanes &= lanes - 1) {
+		const std::size_t row = first + static_cast<unsigned int>(__builtin_ctz(lanes));
+		if (errors[row] != ErrorCode::None) continue;
+		errors[row] = error;
+		errorOffsets[row] = offset;
+	}
+}
+
+calc::Result calc::ColumnarFormula::evaluateRow(const std::vector<const double*>& columns, std::size_t row) {
+	using classes::NodeType;
+
+	Result result;
+	std::size_t top = 0;
+	for (classes::FlatAST::Node n = 0; n < tree.size(); ++n) {
+		const classes::FlatNode& node = tree[n];
+		switch (node.type) {
+		case NodeType::Value: scalarStack[top++] = node.constant; break;
+		case NodeType::Variable:
+			result.error = VariableTable::toNumber(columns[node.left][row], scalarStack[top++]);
+			break;
+
+		case NodeType::Negation: scalarStack[top - 1] = scalarStack[top - 1].negated(); break;
+
+		case NodeType::Add:
+		case NodeType::Subtract:
+			--top;
+			result.error = utils::addOrSubtract(
+				scalarStack[top - 1], scalarStack[top], node.type == NodeType::Subtract, scalarStack[top - 1]);
+			break;
+
+		case NodeType::Multiply:
+		case NodeType::Divide:
+			--top;
+			result.error = utils::multiplyOrDivide(
+				scalarStack[top - 1], scalarStack[top], node.type == NodeType::Divide, scalarStack[top - 1]);
+			break;
+
+		case NodeType::Fold: throw std::logic_error("Unexpected fold in ColumnarFormula::evaluateRow method");
+		}
+
+		if (!result) {
+			result.offset = node.position;
+			return result;
+		}
+	}
+
+	result.answer = utils::roundAnswer(scalarStack[0]);
+	return result;
+}
@@ -0,0 +1,69 @@
+#ifndef COLUMNAR_H
+#define COLUMNAR_H
+
+#include "calculator.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+// Columnar Formulas
+// one formula evaluated over columns of inputs, one column per variable and one result per row. Rows are evaluated
+// BLOCK_SIZE at a time: each node of the formula runs as one kernel over the whole block, with AVX2 or NEON when the
+// build targets them and one row at a time otherwise. Errors are tracked per row, and only the first one of each row
+// is kept, like in every other engine. Rows whose exact integers grow past 2 ^ 53, which doubles can't hold, are
+// evaluated again one by one, so every row gets the same result as Formula::evaluate()
+namespace calc {
+
+    class ColumnarFormula {
+    public:
+
+        static inline constexpr std::size_t BLOCK_SIZE = 256;
+
+        explicit ColumnarFormula(classes::FlatAST&& tree);
+        // tree is simplified first. Built by Calculator::compileColumnar(), which parses tree with variables allowed
+
+        [[nodiscard]] const std::vector<std::string>& variableNames() const { return tree.variableNames(); }
+
+        void evaluate(const std::vector<const double*>& columns, std::size_t numRows, Result* results);
+        // columns[i] holds the numRows values of variableNames()[i], which are converted like VariableTable::set()
+        // does. An input out of bounds is an Overflow at the variable. results needs room for numRows results
+
+        [[nodiscard]] std::size_t getNumScalarRows() const { return numScalarRows; }
+        // rows of the last evaluate() that had to be evaluated one by one
+
+        [[nodiscard]] static const char* getInstructionSet(); // "AVX2", "NEON" or "scalar"
+
+    private:
+
+        struct alignas(64) Block { // values of one node for every row of a block
+            double value[BLOCK_SIZE]; // the integer itself for integer rows
+            double magnitude[BLOCK_SIZE]; // only used by rows that aren't integers, like in Number
+            double isInteger[BLOCK_SIZE]; // masks, as the lanes compare operations give them
+        };
+
+        classes::FlatAST tree;
+        std::vector<Block> stack; // one block per value on the stack of a post-order evaluation
+        std::vector<const Block*> operands; // the blocks of the values on the stack, which can also be inputs
+        std::vector<Block> inputs; // one block per column, converted once per block of rows
+        std::vector<unsigned int> outOfBounds; // per column, lanes of the inputs out of bounds, at each vector's first row
+        alignas(64) double answers[BLOCK_SIZE];
+        ErrorCode errors[BLOCK_SIZE]; // first error of each row
+        unsigned int errorOffsets[BLOCK_SIZE];
+        bool isScalar[BLOCK_SIZE]; // rows to evaluate again one by one
+        std::vector<classes::Number> scalarStack;
+        std::size_t numScalarRows = 0;
+
+        void evaluateBlock(const std::vector<const double*>& columns, std::size_t begin, std::size_t numRows,
+                           Result* results);
+
+        void fail(unsigned int lanes, std::size_t first, ErrorCode error, unsigned int offset);
+        // records error at the rows of the set bits of lanes, counted from row first, unless they already have one
+
+        [[nodiscard]] Result evaluateRow(const std::vector<const double*>& columns, std::size_t row);
+    };
+
+}
+
+#endif //COLUMNAR_H
@@ -0,0 +1,798 @@
+#ifndef COMPILE_TIME_H
+#define COMPILE_TIME_H
+
+#include "calculator.h"
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+
+// Compile-Time Evaluation
+// the whole calculation in constexpr functions, so that the compiler can parse and evaluate constant expressions:
+//     constexpr double answer = calc::eval("4*21/(8+3)");
+// where an invalid expression stops the compilation. The grammar, the arithmetic and the rounding are the same as in
+// Calculator::tryCalculate(), but without the std::pow and std::log10 behind utils::powerOfTen() and
+// utils::getScientificMagnitude(), which aren't constexpr: powers of ten are computed exactly with big integers and
+// rounded once, and magnitudes come from the thresholds where std::log10 reaches each integer, written down below. The
+// tests check both against the power tables filled at run time, so that answers are the same.
+// Everything lives on the stack in buffers of fixed capacity, sized for expressions nested up to MAX_DEPTH levels
+namespace calc::compile_time {
+
+    inline constexpr bool isDigit(char c) { return c >= '0' && c <= '9'; }
+    inline constexpr bool isOperator(char c) { return c == '+' || c == '-' || c == '*' || c == '/'; }
+
+    // Big Integers
+    // unsigned, little-endian in 32-bit limbs, large enough for 5 ^ 400 shifted left by 64 bits. Only used to compute
+    // powers of ten exactly
+    class BigInteger {
+    public:
+
+        static inline constexpr std::size_t NUM_LIMBS = 36; // 1152 bits
+
+        constexpr explicit BigInteger(std::uint32_t value = 0) { limbs[0] = value; }
+
+        constexpr void multiply(std::uint64_t factor) {
+            unsigned __int128 carry = 0;
+            for (std::uint32_t& limb : limbs) {
+                const unsigned __int128 product = static_cast<unsigned __int128>(limb) * factor + carry;
+                limb = static_cast<std::uint32_t>(product);
+                carry = product >> 32;
+            }
+        }
+
+        constexpr void subtract(const BigInteger& other) { // other can't be larger
+            std::uint64_t borrow = 0;
+            for (std::size_t i = 0; i < NUM_LIMBS; ++i) {
+                const std::uint64_t difference = std::uint64_t{limbs[i]} - other.limbs[i] - borrow;
+                limbs[i] = static_cast<std::uint32_t>(difference);
+                borrow = difference >> 63;
+            }
+        }
+
+        constexpr void shiftLeft(unsigned int bits) {
+            const std::size_t limbShift = bits / 32;
+            const unsigned int bitShift = bits % 32;
+            for (std::size_t i = NUM_LIMBS; i-- > 0;) {
+                std::uint64_t shifted = 0;
+                if (i >= limbShift) shifted = std::uint64_t{limbs[i - limbShift]} << bitShift;
+                if (bitShift != 0 && i >= limbShift + 1) shifted |= limbs[i - limbShift - 1] >> (32 - bitShift);
+                limbs[i] = static_cast<std::uint32_t>(shifted);
+            }
+        }
+
+        [[nodiscard]] constexpr int compare(const BigInteger& other) const {
+            for (std::size_t i = NUM_LIMBS; i-- > 0;)
+                if (limbs[i] != other.limbs[i]) return limbs[i] < other.limbs[i] ? -1 : 1;
+            return 0;
+        }
+
+        [[nodiscard]] constexpr bool isZero() const { return compare(BigInteger()) == 0; }
+
+        [[nodiscard]] constexpr unsigned int bitLength() const {
+            for (std::size_t i = NUM_LIMBS; i-- > 0;) {
+                if (limbs[i] == 0) continue;
+                unsigned int length = 32 * static_cast<unsigned int>(i);
+                for (std::uint32_t limb = limbs[i]; limb != 0; limb >>= 1) ++length;
+                return length;
+            }
+            return 0;
+        }
+
+        [[nodiscard]] constexpr std::uint64_t topBits(bool& isInexact) const {
+            // the 64 bits starting at the most significant one, and whether any bit below them is set
+            const unsigned int length = bitLength();
+            std::uint64_t top = 0;
+            isInexact = false;
+            for (unsigned int bit = length; bit-- > 0;) {
+                const bool isSet = (limbs[bit / 32] >> (bit % 32)) & 1;
+                if (bit + 64 >= length) top = (top << 1) | static_cast<std::uint64_t>(isSet);
+                else if (isSet) {
+                    isInexact = true;
+                    break;
+                }
+            }
+            return length < 64 ? top << (64 - length) : top;
+        }
+
+    private:
+
+        std::uint32_t limbs[NUM_LIMBS] = {};
+    };
+
+    inline constexpr BigInteger powerOfFive(unsigned int exponent) {
+        BigInteger power(1);
+        for (; exponent >= 27; exponent -= 27) power.multiply(7450580596923828125ULL); // the largest in 64 bits
+        std::uint64_t rest = 1;
+        for (; exponent > 0; --exponent) rest *= 5;
+        power.multiply(rest);
+        return power;
+    }
+
+    inline constexpr double scaleByPowerOfTwo(double value, int exponent) { // exact when the result is representable
+        constexpr double TWO_TO_64 = 18446744073709551616.0;
+        for (; exponent >= 64; exponent -= 64) value *= TWO_TO_64;
+        for (; exponent <= -64; exponent += 64) value /= TWO_TO_64;
+        for (; exponent > 0; --exponent) value *= 2;
+        for (; exponent < 0; ++exponent) value /= 2;
+        return value;
+    }
+
+    inline constexpr double roundToDouble(std::uint64_t mantissa, bool isInexact, int exponent) {
+        // value is mantissa * 2 ^ exponent, plus a fraction of 2 ^ exponent when isInexact, and the top bit of
+        // mantissa is set. Rounded to nearest even once, keeping fewer than 53 bits for subnormal results
+        int numDropped = 11;
+        if (exponent + numDropped < -1074) numDropped = -1074 - exponent;
+        if (numDropped > 64) return 0;
+        if (numDropped == 64) return mantissa > (1ULL << 63) || isInexact ? scaleByPowerOfTwo(1, -1074) : 0;
+
+        std::uint64_t kept = mantissa >> numDropped;
+        const std::uint64_t rest = mantissa & ((1ULL << numDropped) - 1);
+        const std::uint64_t half = 1ULL << (numDropped - 1);
+        if (rest > half || (rest == half && (isInexact || (kept & 1) != 0))) ++kept;
+        return scaleByPowerOfTwo(static_cast<double>(kept), exponent + numDropped);
+    }
+
+    inline constexpr double computePowerOfTen(int exponent) {
+        if (exponent >= 0) {
+            bool isInexact = false;
+            const BigInteger power = powerOfFive(static_cast<unsigned int>(exponent));
+            const std::uint64_t top = power.topBits(isInexact);
+            return roundToDouble(top, isInexact, static_cast<int>(power.bitLength()) - 64 + exponent);
+        }
+
+        // 10 ^ -n = 2 ^ -n / 5 ^ n, by long division one bit at a time. 5 ^ n isn't a power of two, so starting with
+        // the power of two just below it gives a quotient of exactly 64 bits
+        const auto n = static_cast<unsigned int>(-exponent);
+        const BigInteger divisor = powerOfFive(n);
+        const unsigned int length = divisor.bitLength();
+        BigInteger remainder(1);
+        remainder.shiftLeft(length - 1);
+        std::uint64_t quotient = 0;
+        for (unsigned int bit = 0; bit < 64; ++bit) {
+            remainder.shiftLeft(1);
+            quotient <<= 1;
+            if (remainder.compare(divisor) >= 0) {
+                remainder.subtract(divisor);
+                quotient |= 1;
+            }
+        }
+        return roundToDouble(quotient, !remainder.isZero(), -static_cast<int>(length) - 63 - static_cast<int>(n));
+    }
+
+    inline constexpr double round(double value) { // half away from zero, like std::round()
+        const double absolute = value < 0 ? -value : value;
+        if (!(absolute < 4503599627370496.0)) return value; // 2 ^ 52 and above are integers already
+        double rounded = static_cast<double>(static_cast<long long>(absolute));
+        if (absolute - rounded >= 0.5) rounded += 1;
+        return value < 0 ? -rounded : rounded;
+    }
+
+    // smallest double x with floor(std::log10(x)) >= exponent, from MIN_THRESHOLD to MAX_THRESHOLD: utils::PowerTables
+    // holds the same ones from -307, and below them are those of subnormal values. Near powers of ten, glibc's
+    // std::log10 is sometimes one ulp away from the correctly rounded logarithm, so the thresholds are written down
+    // instead of computed
+    inline constexpr int MIN_THRESHOLD = -323; // 10 ^ -324 is below the smallest subnormal
+    inline constexpr int MAX_THRESHOLD = utils::PowerTables::MAX_THRESHOLD;
+    inline constexpr double THRESHOLDS[MAX_THRESHOLD - MIN_THRESHOLD + 1] = {
+        0x0.0000000000003p-1022, 0x0.0000000000015p-1022, 0x0.00000000000cbp-1022, 0x0.00000000007e9p-1022,
+        0x0.0000000004f11p-1022, 0x0.00000000316a3p-1022, 0x0.00000001ee257p-1022, 0x0.000000134d762p-1022,
+        0x0.000000c1069cep-1022, 0x0.0000078a42206p-1022, 0x0.00004b6695433p-1022, 0x0.0002f201d49fcp-1022,
+        0x0.001d74124e3d1p-1022, 0x0.012688b70e62ap-1022, 0x0.0b8157268fda2p-1022, 0x0.730d67819e84ep-1022,
+        0x1.1fa182c40c4c3p-1020, 0x1.6789e3750f5f3p-1017, 0x1.c16c5c525337p-1014, 0x1.18e3b9b374026p-1010,
+        0x1.5f1ca8205102fp-1007, 0x1.b6e3d2286543bp-1004, 0x1.124e63593f4a5p-1000, 0x1.56e1fc2f8f1cep-997,
+        0x1.ac9a7b3b72e42p-994, 0x1.0be08d0527ce9p-990, 0x1.4ed8b04671c23p-987, 0x1.a28edc580e32cp-984,
+        0x1.059949b708dfcp-980, 0x1.46ff9c24cb17bp-977, 0x1.98bf832dfddd9p-974, 0x1.feef63f97d55p-971,
+        0x1.3f559e7bee552p-967, 0x1.8f2b061ae9ea6p-964, 0x1.f2f5c7a1a465p-961, 0x1.37d99cc506bf2p-957,
+        0x1.85d003f6486eep-954, 0x1.e74404f3da8aap-951, 0x1.308a83186896ap-947, 0x1.7cad23de82bc5p-944,
+        0x1.dbd86cd6236b6p-941, 0x1.29674405d6231p-937, 0x1.73c115074babep-934, 0x1.d0b15a491e96ep-931,
+        0x1.226ed86db31e4p-927, 0x1.6b0a8e891fe5ep-924, 0x1.c5cd322b67df5p-921, 0x1.1ba03f5b20eb9p-917,
+        0x1.62884f31e9268p-914, 0x1.bb2a62fe63701p-911, 0x1.14fa7ddefe261p-907, 0x1.5a391d56bdaf9p-904,
+        0x1.b0c764ac6d1b7p-901, 0x1.0e7c9eebc4313p-897, 0x1.521bc6a6b53d7p-894, 0x1.a6a2b850628cdp-891,
+        0x1.0825b3323d98p-887, 0x1.4a2f1ffeccfep-884, 0x1.9cbae7fe803d8p-881, 0x1.01f4d0ff10267p-877,
+        0x1.4272053ed4301p-874, 0x1.930e868e893c1p-871, 0x1.f7d228322b8b2p-868, 0x1.3ae3591f5b36fp-864,
+        0x1.899c2f673204bp-861, 0x1.ec033b40fe85dp-858, 0x1.338205089f13ap-854, 0x1.8062864ac6d89p-851,
+        0x1.e07b27dd78ap-848, 0x1.2c4cf8ea6b64p-844, 0x1.77603725063dp-841, 0x1.d53844ee47cc4p-838,
+        0x1.25432b14ecdfap-834, 0x1.6e93f5da28179p-831, 0x1.ca38f350b21d7p-828, 0x1.1e6398126f526p-824,
+        0x1.65fc7e170b27p-821, 0x1.bf7b9d9ccdf0cp-818, 0x1.17ad428200b68p-814, 0x1.5d98932280e41p-811,
+        0x1.b4feb7eb211d2p-808, 0x1.111f32f2f4b23p-804, 0x1.5566ffafb1decp-801, 0x1.aac0bf9b9e567p-798,
+        0x1.0ab877c142f6p-794, 0x1.4d6695b193b38p-791, 0x1.a0c03b1df8a07p-788, 0x1.047824f2bb644p-784,
+        0x1.45962e2f6a3d5p-781, 0x1.96fbb9bb44ccap-778, 0x1.fcbaa82a15ffdp-775, 0x1.3df4a91a4dbfep-771,
+        0x1.8d71d360e12fdp-768, 0x1.f0ce4839197bdp-765, 0x1.3680ed23afed6p-761, 0x1.8421286c9be8cp-758,
+        0x1.e5297287c2e2fp-755, 0x1.2f39e794d9cddp-751, 0x1.7b08617a10415p-748, 0x1.d9ca79d89451ap-745,
+        0x1.281e8c275cb3p-741, 0x1.72262f3133dfcp-738, 0x1.ceafbafd80d7bp-735, 0x1.212dd4de7086dp-731,
+        0x1.69794a160ca88p-728, 0x1.c3d79c9b8fd2ap-725, 0x1.1a66c1e139e3ap-721, 0x1.61007259885c9p-718,
+        0x1.b9408eefea73bp-715, 0x1.13c85955f2885p-711, 0x1.58ba6fab6f2a6p-708, 0x1.aee90b964af5p-705,
+        0x1.0d51a73deed92p-701, 0x1.50a6110d6a8f6p-698, 0x1.a4cf9550c5334p-695, 0x1.0701bd527b4p-691,
+        0x1.48c22ca71a101p-688, 0x1.9af2b7d0e0941p-685, 0x1.00d7b2e28c5c8p-681, 0x1.410d9f9b2f73ap-678,
+        0x1.91510781fb509p-675, 0x1.f5a549627a24bp-672, 0x1.39874ddd8c56fp-668, 0x1.87e92154ef6cbp-665,
+        0x1.e9e369aa2b47ep-662, 0x1.322e220a5b0cfp-658, 0x1.7eb9aa8cf1d02p-655, 0x1.de6815302e443p-652,
+        0x1.2b010d3e1ceaap-648, 0x1.75c1508da4254p-645, 0x1.d331a4b10d2e9p-642, 0x1.23ff06eea83d2p-638,
+        0x1.6cfec8aa524c6p-635, 0x1.c83e7ad4e6df8p-632, 0x1.1d270cc5104bap-628, 0x1.6470cff6545e9p-625,
+        0x1.bd8d03f3e9764p-622, 0x1.1678227871e9ep-618, 0x1.5c162b168e646p-615, 0x1.b31bb5dc31fd8p-612,
+        0x1.0ff151a99f3e6p-608, 0x1.53eda614070ep-605, 0x1.a8e90f9908d18p-602, 0x1.0991a9bfa582fp-598,
+        0x1.4bf6142f8ee3bp-595, 0x1.9ef3993b729cap-592, 0x1.03583fc527a1ep-588, 0x1.442e4fb6718a6p-585,
+        0x1.9539e3a40decfp-582, 0x1.fa885c8d11683p-579, 0x1.3c9539d82ae12p-575, 0x1.8bba884e35996p-572,
+        0x1.eea92a61c2ffcp-569, 0x1.3529ba7d19dfep-565, 0x1.8274291c6057dp-562, 0x1.e3113363786dcp-559,
+        0x1.2deac01e2b44ap-555, 0x1.79657025b615bp-552, 0x1.d7becc2f239b3p-549, 0x1.26d73f9d7641p-545,
+        0x1.708d0f84d3d13p-542, 0x1.ccb0536608c59p-539, 0x1.1fee341fc57b8p-535, 0x1.67e9c127b6da5p-532,
+        0x1.c1e43171a490fp-529, 0x1.192e9ee706da9p-525, 0x1.5f7a46a0c8913p-522, 0x1.b758d848fab58p-519,
+        0x1.1297872d9cb17p-515, 0x1.573d68f903dddp-512, 0x1.ad0cc33744d54p-509, 0x1.0c27fa028b055p-505,
+        0x1.4f31f8832dc6ap-502, 0x1.a2fe76a3f9384p-499, 0x1.05df0a267bc33p-495, 0x1.4756ccb01ab3fp-492,
+        0x1.992c7fdc2160fp-489, 0x1.ff779fd329b93p-486, 0x1.3faac3e3fa13cp-482, 0x1.8f9574dcf898bp-479,
+        0x1.f37ad21436bedp-476, 0x1.382cc34ca2374p-472, 0x1.8637f41fcac51p-469, 0x1.e7c5f127bd766p-466,
+        0x1.30dbb6b8d669fp-462, 0x1.7d12a4670c048p-459, 0x1.dc574d80cf059p-456, 0x1.29b6907081638p-452,
+        0x1.7424348ca1bc6p-449, 0x1.d12d41afca2b7p-446, 0x1.22bc490dde5b2p-442, 0x1.6b6b5b5155f1fp-439,
+        0x1.c6463225ab6e7p-436, 0x1.1bebdf578b25p-432, 0x1.62e6d72d6dee5p-429, 0x1.bba08cf8c969ep-426,
+        0x1.1544581b7de72p-422, 0x1.5a956e225d60fp-419, 0x1.b13ac9aaf4b92p-416, 0x1.0ec4be0ad8f3bp-412,
+        0x1.5275ed8d8f30bp-409, 0x1.a71368f0f2fcdp-406, 0x1.086c219697dep-402, 0x1.4a8729fc3dd58p-399,
+        0x1.9d28f47b4d4aep-396, 0x1.023998cd104edp-392, 0x1.42c7ff0054628p-389, 0x1.9379fec0697b2p-386,
+        0x1.f8587e7083d9fp-383, 0x1.3b374f0652683p-379, 0x1.8a0522c7e7024p-376, 0x1.ec866b79e0c2dp-373,
+        0x1.33d4032c2c79cp-369, 0x1.80c903f737983p-366, 0x1.e0fb44f5057e4p-363, 0x1.2c9d0b19236efp-359,
+        0x1.77c44ddf6c4aap-356, 0x1.d5b56157475d5p-353, 0x1.25915cd68c9a5p-349, 0x1.6ef5b40c2fc0ep-346,
+        0x1.cab3210f3bb12p-343, 0x1.1eaff4a9854ebp-339, 0x1.665bf1d3e6a26p-336, 0x1.bff2ee48e04afp-333,
+        0x1.17f7d4ed8c2edp-329, 0x1.5df5ca28ef3a9p-326, 0x1.b5733cb32b093p-323, 0x1.116805effae5cp-319,
+        0x1.55c2076bf99f3p-316, 0x1.ab328946f807p-313, 0x1.0aff95cc5b045p-309, 0x1.4dbf7b3f71c57p-306,
+        0x1.a12f5a0f4e36dp-303, 0x1.04bd984990e24p-299, 0x1.45ecfe5bf51adp-296, 0x1.97683df2f2618p-293,
+        0x1.fd424d6faef9fp-290, 0x1.3e497065cd5c3p-286, 0x1.8ddbcc7f40b34p-283, 0x1.f152bf9f10e01p-280,
+        0x1.36d3b7c36a8cp-276, 0x1.8488a5b4452f1p-273, 0x1.e5aacf21567adp-270, 0x1.2f8ac174d60ccp-266,
+        0x1.7b6d71d20b8ffp-263, 0x1.da48ce468e73fp-260, 0x1.286d80ec19087p-256, 0x1.7288e1271f4a9p-253,
+        0x1.cf2b1970e71d3p-250, 0x1.217aefe690724p-246, 0x1.69d9abe0348edp-243, 0x1.c45016d841b28p-240,
+        0x1.1ab20e47290f9p-236, 0x1.615e91d8f3538p-233, 0x1.b9b6364f30286p-230, 0x1.1411e1f17e194p-226,
+        0x1.59165a6ddd9f8p-223, 0x1.af5bf10955076p-220, 0x1.0d9976a5d524ap-216, 0x1.50ffd44f4a6ddp-213,
+        0x1.a53fc9631d0dp-210, 0x1.0747ddddf2282p-206, 0x1.4919d5556eb23p-203, 0x1.9b604aaaca5ebp-200,
+        0x1.011c2eaabe7b3p-196, 0x1.41633a556e1ap-193, 0x1.91bc08eac9a08p-190, 0x1.f62b0b257c08ap-187,
+        0x1.39dae6f76d856p-183, 0x1.8851a0b548e6cp-180, 0x1.ea6608e29b207p-177, 0x1.327fc58da0f44p-173,
+        0x1.7f1fb6f109315p-170, 0x1.dee7a4ad4b7dap-167, 0x1.2b50c6ec4f2e8p-163, 0x1.7624f8a762fa3p-160,
+        0x1.d3ae36d13bb8bp-157, 0x1.244ce242c5537p-153, 0x1.6d601ad376a85p-150, 0x1.c8b8218854526p-147,
+        0x1.1d7314f534b38p-143, 0x1.64cfda3281e06p-140, 0x1.be03d0bf22587p-137, 0x1.16c2627775774p-133,
+        0x1.5c72fb1552d52p-130, 0x1.b38fb9daa78a6p-127, 0x1.1039d428a8b68p-123, 0x1.54484932d2e42p-120,
+        0x1.a95a5b7f879d2p-117, 0x1.09d8792fb4c23p-113, 0x1.4c4e977ba1f2cp-110, 0x1.9f623d5a8a6f7p-107,
+        0x1.039d66589686dp-103, 0x1.4484bfeebc289p-100, 0x1.95a5efea6b32bp-97, 0x1.fb0f6be505ff5p-94,
+        0x1.3ce9a36f23bf9p-90, 0x1.8c240c4aecaf8p-87, 0x1.ef2d0f5da7db6p-84, 0x1.357c299a88e92p-80,
+        0x1.82db34012b236p-77, 0x1.e392010175ec3p-74, 0x1.2e3b40a0e9b3ap-70, 0x1.79ca10c924208p-67,
+        0x1.d83c94fb6d28bp-64, 0x1.2725dd1d24397p-60, 0x1.70ef54646d47cp-57, 0x1.cd2b297d8899bp-54,
+        0x1.203af9ee7560bp-50, 0x1.6849b86a12b8ep-47, 0x1.c25c268497672p-44, 0x1.19799812dea07p-40,
+        0x1.5fd7fe1796489p-37, 0x1.b7cdfd9d7bdabp-34, 0x1.12e0be826d68bp-30, 0x1.5798ee2308c2ep-27,
+        0x1.ad7f29abcaf41p-24, 0x1.0c6f7a0b5ed88p-20, 0x1.4f8b588e368ebp-17, 0x1.a36e2eb1c4325p-14,
+        0x1.0624dd2f1a9fap-10, 0x1.47ae147ae1478p-7, 0x1.9999999999998p-4, 0x1p+0,
+        0x1.4p+3, 0x1.8ffffffffffffp+6, 0x1.f3ffffffffffbp+9, 0x1.387fffffffffep+13,
+        0x1.869fffffffffap+16, 0x1.e847ffffffff7p+19, 0x1.312cffffffffbp+23, 0x1.7d783fffffffap+26,
+        0x1.dcd64ffffffeep+29, 0x1.2a05f1ffffff6p+33, 0x1.74876e7fffff3p+36, 0x1.d1a94a1ffffefp+39,
+        0x1.2309ce53ffff6p+43, 0x1.6bcc41e8ffff4p+46, 0x1.c6bf52633fffp+49, 0x1.1c37937e07ff6p+53,
+        0x1.6345785d89fe7p+56, 0x1.bc16d674ec7ep+59, 0x1.158e460913cecp+63, 0x1.5af1d78b58c28p+66,
+        0x1.b1ae4d6e2ef31p+69, 0x1.0f0cf064dd57fp+73, 0x1.52d02c7e14adfp+76, 0x1.a784379d99d96p+79,
+        0x1.08b2a2c28027ep+83, 0x1.4adf4b732031dp+86, 0x1.9d971e4fe83e5p+89, 0x1.027e72f1f126fp+93,
+        0x1.431e0fae6d70bp+96, 0x1.93e5939a08ccdp+99, 0x1.f8def8808bp+102, 0x1.3b8b5b5056ep+106,
+        0x1.8a6e32246c964p+109, 0x1.ed09bead87bbdp+112, 0x1.3426172c74d56p+116, 0x1.812f9cf7920acp+119,
+        0x1.e17b8435768d6p+122, 0x1.2ced32a16a186p+126, 0x1.78287f49c49e7p+129, 0x1.d6329f1c35c62p+132,
+        0x1.25dfa371a19bdp+136, 0x1.6f578c4e0a02cp+139, 0x1.cb2d6f618c836p+142, 0x1.1efc659cf7d23p+146,
+        0x1.66bb7f0435c6bp+149, 0x1.c06a5ec543386p+152, 0x1.18427b3b4a034p+156, 0x1.5e531a0a1c841p+159,
+        0x1.b5e7e08ca3a51p+162, 0x1.11b0ec57e6473p+166, 0x1.561d276ddfd8fp+169, 0x1.aba4714957cf3p+172,
+        0x1.0b46c6cdd6e18p+176, 0x1.4e1878814c99ep+179, 0x1.a19e96a19fc05p+182, 0x1.05031e2503d84p+186,
+        0x1.4643e5ae44ce4p+189, 0x1.97d4df19d601dp+192, 0x1.fdca16e04b824p+195, 0x1.3e9e4e4c2f317p+199,
+        0x1.8e45e1df3afdcp+202, 0x1.f1d75a5709bd3p+205, 0x1.3726987666164p+209, 0x1.84f03e93ff9bdp+212,
+        0x1.e62c4e38ff7e7p+215, 0x1.2fdbb0e39fafp+219, 0x1.7bd29d1c879acp+222, 0x1.dac74463a9816p+225,
+        0x1.28bc8abe49f0fp+229, 0x1.72ebad6ddc6d2p+232, 0x1.cfa698c953887p+235, 0x1.21c81f7dd4354p+239,
+        0x1.6a3a275d49429p+242, 0x1.c4c8b1349b933p+245, 0x1.1afd6ec0e13cp+249, 0x1.61bcca71198bp+252,
+        0x1.ba2bfd0d5fedcp+255, 0x1.145b7e285bf4ap+259, 0x1.59725db272f1cp+262, 0x1.afcef51f0fae3p+265,
+        0x1.0de1593369ccep+269, 0x1.5159af8044401p+272, 0x1.a5b01b6055502p+275, 0x1.078e111c35521p+279,
+        0x1.4971956342a69p+282, 0x1.9bcdfabc13504p+285, 0x1.0160bcb58c123p+289, 0x1.41b8ebe2ef16bp+292,
+        0x1.922726dbaadc6p+295, 0x1.f6b0f09295936p+298, 0x1.3a2e965b9d7c3p+302, 0x1.88ba3bf284db3p+305,
+        0x1.eae8caef2612p+308, 0x1.32d17ed577cb4p+312, 0x1.7f85de8ad5be1p+315, 0x1.df67562d8b2d9p+318,
+        0x1.2ba095dc76fc8p+322, 0x1.7688bb5394bbap+325, 0x1.d42aea2879ea8p+328, 0x1.249ad2594c329p+332,
+        0x1.6dc186ef9f3f3p+335, 0x1.c931e8ab870fp+338, 0x1.1dbf316b34696p+342, 0x1.652efdc60183cp+345,
+        0x1.be7abd3781e4ap+348, 0x1.170cb642b12efp+352, 0x1.5ccfe3d35d7aap+355, 0x1.b403dcc834d95p+358,
+        0x1.108269fd2107dp+362, 0x1.54a3047c6949cp+365, 0x1.a9cbc59b839c3p+368, 0x1.0a1f5b813241ap+372,
+        0x1.4ca732617ed21p+375, 0x1.9fd0fef9de868p+378, 0x1.03e29f5c2b142p+382, 0x1.44db473335d92p+385,
+        0x1.96121900034f6p+388, 0x1.fb969f4004234p+391, 0x1.3d3e23880296p+395, 0x1.8c8dac6a033b8p+398,
+        0x1.efb11784840a6p+401, 0x1.35ceaeb2d2868p+405, 0x1.83425a5f87282p+408, 0x1.e412f0f768f23p+411,
+        0x1.2e8bd69aa1976p+415, 0x1.7a2ecc4149fd3p+418, 0x1.d8ba7f519c7c7p+421, 0x1.27748f9301cddp+425,
+        0x1.7151b377c23aap+428, 0x1.cda62055b2c94p+431, 0x1.2087d4358fbddp+435, 0x1.68a9c942f3ad4p+438,
+        0x1.c2d43b93b0989p+441, 0x1.19c4a53c4e5f6p+445, 0x1.6035ce8b61f73p+448, 0x1.b843422e3a75p+451,
+        0x1.132a095ce4892p+455, 0x1.57f48bb41dab6p+458, 0x1.adf1aea125164p+461, 0x1.0cb70d24b72dfp+465,
+        0x1.4fe4d06de4f96p+468, 0x1.a3de04895e37bp+471, 0x1.066ac2d5dae2dp+475, 0x1.4805738b519b9p+478,
+        0x1.9a06d06e26027p+481, 0x1.00444244d7c18p+485, 0x1.405552d60db1ep+488, 0x1.906aa78b911e6p+491,
+        0x1.f485516e7565fp+494, 0x1.38d352e5095fbp+498, 0x1.8708279e4bb7ap+501, 0x1.e8ca3185dea57p+504,
+        0x1.317e5ef3ab278p+508, 0x1.7dddf6b095f15p+511, 0x1.dd55745cbb6dap+514, 0x1.2a5568b9f5249p+518,
+        0x1.74eac2e8726dbp+521, 0x1.d22573a28f09p+524, 0x1.235768459965bp+528, 0x1.6c2d4256ffbf2p+531,
+        0x1.c73892ecbfaeep+534, 0x1.1c835bd3f7cd5p+538, 0x1.63a432c8f5c0ap+541, 0x1.bc8d3f7b3330cp+544,
+        0x1.15d847acfffe8p+548, 0x1.5b4e59983ffe2p+551, 0x1.b221effe4ffdap+554, 0x1.0f5535fef1fe9p+558,
+        0x1.532a837eae7e2p+561, 0x1.a7f5245e5a1dbp+564, 0x1.08f936baf8529p+568, 0x1.4b378469b6673p+571,
+        0x1.9e0565842401p+574, 0x1.02c35f729680ap+578, 0x1.4374374f3c20dp+581, 0x1.945145230b28fp+584,
+        0x1.f965966bcdf33p+587, 0x1.3bdf7e0360b8p+591, 0x1.8ad75d8438e6p+594, 0x1.ed8d34e5471f8p+597,
+        0x1.3478410f4c73bp+601, 0x1.819651531f90ap+604, 0x1.e1fbe5a7e774cp+607, 0x1.2d3d6f88f0a9p+611,
+        0x1.788ccb6b2cd34p+614, 0x1.d6affe45f8081p+617, 0x1.262dfeebbb051p+621, 0x1.6fb97ea6a9c65p+624,
+        0x1.cba7de505437dp+627, 0x1.1f48eaf234a2fp+631, 0x1.671b25aec1cbap+634, 0x1.c0e1ef1a723e9p+637,
+        0x1.188d357087672p+641, 0x1.5eb082cca940ep+644, 0x1.b65ca37fd3911p+647, 0x1.11f9e62fe43abp+651,
+        0x1.56785fbbdd495p+654, 0x1.ac1677aad49bbp+657, 0x1.0b8e0acac4e15p+661, 0x1.4e718d7d7619ap+664,
+        0x1.a20df0dcd3ap+667, 0x1.0548b68a04441p+671, 0x1.469ae42c8555p+674, 0x1.98419d37a6aa4p+677,
+        0x1.fe5204859054dp+680, 0x1.3ef342d37a351p+684, 0x1.8eb0138858c25p+687, 0x1.f25c186a6ef2ep+690,
+        0x1.37798f428557dp+694, 0x1.8557f31326adcp+697, 0x1.e6adefd7f0592p+700, 0x1.302cb5e6f637cp+704,
+        0x1.7c37e360b3c5ap+707, 0x1.db45dc38e0b71p+710, 0x1.290ba9a38c727p+714, 0x1.734e940c6f8fp+717,
+        0x1.d022390f8b72cp+720, 0x1.221563a9b727cp+724, 0x1.6a9abc9424f1bp+727, 0x1.c5416bb92e2e1p+730,
+        0x1.1b48e353bcdcdp+734, 0x1.621b1c28ac14p+737, 0x1.baa1e332d719p+740, 0x1.14a52dffc66fap+744,
+        0x1.59ce797fb80b8p+747, 0x1.b04217dfa60e7p+750, 0x1.0e294eebc7c91p+754, 0x1.51b3a2a6b9bb4p+757,
+        0x1.a6208b50682a1p+760, 0x1.07d45712411a5p+764, 0x1.49c96cd6d160ep+767, 0x1.9c3bc80c85b92p+770,
+        0x1.01a55d07d393bp+774, 0x1.420eb449c878ap+777, 0x1.9292615c3a96cp+780, 0x1.f736f9b3493c8p+783,
+        0x1.3a825c100dc5dp+787, 0x1.8922f31411374p+790, 0x1.eb6bafd91585p+793, 0x1.33234de7ad733p+797,
+        0x1.7fec216198cffp+800, 0x1.dfe729b9ff03fp+803, 0x1.2bf07a143f627p+807, 0x1.76ec98994f3b1p+810,
+        0x1.d4a7bebfa309dp+813, 0x1.24e8d737c5e63p+817, 0x1.6e230d05b75fbp+820, 0x1.c9abd0472537ap+823,
+        0x1.1e0b622c7742cp+827, 0x1.658e3ab795137p+830, 0x1.bef1c9657a585p+833, 0x1.17571ddf6c773p+837,
+        0x1.5d2ce5574795p+840, 0x1.b4781ead197a4p+843, 0x1.10cb132c2fec6p+847, 0x1.54fdd7f73be78p+850,
+        0x1.aa3d4df50ad2p+853, 0x1.0a6650b926c35p+857, 0x1.4cffe4e770741p+860, 0x1.a03fde214c912p+863,
+        0x1.0427ead4cfdabp+867, 0x1.4531e58a03d16p+870, 0x1.967e5eec84c5bp+873, 0x1.fc1df6a7a5f71p+876,
+        0x1.3d92ba28c7ba8p+880, 0x1.8cf768b2f9a91p+883, 0x1.f03542dfb8136p+886, 0x1.362149cbd30c2p+890,
+        0x1.83a99c3ec7cf2p+893, 0x1.e494034e79c2dp+896, 0x1.2edc82110c19dp+900, 0x1.7a93a2954f204p+903,
+        0x1.d9388b3aa2e85p+906, 0x1.27c35704a5d13p+910, 0x1.71b42cc5cf458p+913, 0x1.ce2137f74316dp+916,
+        0x1.20d4c2fa89ee5p+920, 0x1.6909f3b92c69ep+923, 0x1.c34c70a777845p+926, 0x1.1a0fc668aab2cp+930,
+        0x1.6093b802d55f6p+933, 0x1.b8b8a6038ab74p+936, 0x1.137367c236b29p+940, 0x1.585041b2c45f2p+943,
+        0x1.ae64521f7576fp+946, 0x1.0cfeb353a96a6p+950, 0x1.503e602893c4fp+953, 0x1.a44df832b8b63p+956,
+        0x1.06b0bb1fb371ep+960, 0x1.485ce9e7a04e5p+963, 0x1.9a7424618861ep+966, 0x1.008896bcf53d3p+970,
+        0x1.40aabc6c328c8p+973, 0x1.90d56b873f2f9p+976, 0x1.f50ac6690efb7p+979, 0x1.3926bc01a95d3p+983,
+        0x1.87706b0213b48p+986, 0x1.e94c85c298a19p+989, 0x1.31cfd3999f65p+993, 0x1.7e43c880073e4p+996,
+        0x1.ddd4baa0090dcp+999, 0x1.2aa4f4a405a8ap+1003, 0x1.754e31cd0712dp+1006, 0x1.d2a1be4048d77p+1009,
+        0x1.23a516e82d86bp+1013, 0x1.6c8e5ca238e86p+1016, 0x1.c7b1f3cac7226p+1019, 0x1.1ccf385ebc759p+1023
+    };
+
+    // Numbers
+    // same as ScientificValue and Number, which can't be used in constexpr functions
+    struct Scientific {
+        double value = 0;
+        int magnitude = 0;
+    };
+
+    struct Value {
+        long long integer = 0;
+        double value = 0;
+        int magnitude = 0;
+        bool isInteger = false;
+    };
+
+    // Arithmetic
+    // the functions of calc::utils on Scientific and Value, with the powers of ten computed so far cached
+    class Arithmetic {
+    public:
+
+        static inline constexpr int MIN_POWER = -400; // same range as utils::PowerTables
+        static inline constexpr int MAX_POWER = 400;
+
+        constexpr double powerOfTen(int exponent) {
+            if (exponent < MIN_POWER) return 0;
+            if (exponent > MAX_POWER) return scaleByPowerOfTwo(1, 1024); // infinity
+            const auto i = static_cast<std::size_t>(exponent - MIN_POWER);
+            if (!isKnown[i]) {
+                // std::pow rounds these two up, 10 ^ 23 being halfway between two doubles
+                if (exponent == 23) powers[i] = 0x1.52d02c7e14af7p+76;
+                else if (exponent == 210) powers[i] = 0x1.8557f31326bbcp+697;
+                else powers[i] = computePowerOfTen(exponent);
+                isKnown[i] = true;
+            }
+            return powers[i];
+        }
+
+        static constexpr bool hasMagnitude(double value, int exponent) { // floor(log10(value)) >= exponent
+            if (exponent < MIN_THRESHOLD) return true;
+            if (exponent > MAX_THRESHOLD) return false;
+            return value >= THRESHOLDS[exponent - MIN_THRESHOLD];
+        }
+
+        constexpr int getScientificMagnitude(double value) {
+            if (value == 0.0) return 0;
+            const double absolute = value < 0 ? -value : value;
+            // makeScientific() gives NaN below 10 ^ -295. At run time, what follows depends on how the compiler optimized
+            // the conversion of std::floor(std::log10(NaN)) and the additions after it. Here, like in unoptimized x86
+            // code, the magnitude is INT_MIN and magnitudes are added and negated with wraparound
+            if (!(absolute <= 1.7976931348623157e308)) return INT_MIN;
+            std::uint64_t mantissa = 0;
+            int binaryExponent = 0;
+            split(absolute, mantissa, binaryExponent);
+            const int magnitude = ((binaryExponent + 52) * 78913) >> 18; // see utils::getScientificMagnitude()
+            return hasMagnitude(absolute, magnitude + 1) ? magnitude + 1 : magnitude;
+        }
+
+        constexpr Scientific makeScientific(double value, unsigned int lastDigit = MAX_DIGITS + 1) {
+            if (value == 0.0) return {0.0, 0};
+            const int magnitude = getScientificMagnitude(value);
+            const int rounded = wrap(static_cast<long long>(lastDigit) - 1 - magnitude);
+            const double exponent = powerOfTen(rounded);
+            value = compile_time::round(value * exponent) / exponent;
+            value = value / powerOfTen(magnitude);
+            return {value, magnitude};
+        }
+
+        constexpr double rawValue(const Scientific& scientific) {
+            return scientific.value * powerOfTen(scientific.magnitude);
+        }
+
+        constexpr bool isBounded(double value) { return isMagnitudeBounded(getScientificMagnitude(value)); }
+
+        static constexpr bool isProductBounded(int magnitude1, int magnitude2) {
+            return isMagnitudeBounded(wrap(static_cast<long long>(magnitude1) + magnitude2));
+        }
+
+        constexpr ErrorCode addOrSubtract(const Scientific& left, const Scientific& right, bool isSub,
+                                          Scientific& result) {
+            const double rawLeft = rawValue(left);
+            const double rawRight = rawValue(right);
+            const double rawSum = isSub ? rawLeft - rawRight : rawLeft + rawRight;
+            if (!isBounded(rawSum)) return ErrorCode::Overflow;
+            result = makeScientific(rawSum);
+            return ErrorCode::None;
+        }
+
+        constexpr ErrorCode multiplyOrDivide(const Scientific& left, const Scientific& right, bool isDiv,
+                                             Scientific& result) {
+            if (isDiv) {
+                if (right.value == 0.0) return ErrorCode::DivisionByZero;
+                if (!isProductBounded(left.magnitude, wrap(-static_cast<long long>(right.magnitude))))
+                    return ErrorCode::Overflow;
+                result = makeScientific(rawValue(left) / rawValue(right));
+                return ErrorCode::None;
+            }
+            if (!isProductBounded(left.magnitude, right.magnitude)) return ErrorCode::Overflow;
+            result = makeScientific(rawValue(left) * rawValue(right));
+            return ErrorCode::None;
+        }
+
+        constexpr Scientific toScientific(const Value& number) {
+            if (!number.isInteger) return {number.value, number.magnitude};
+            return makeScientific(static_cast<double>(number.integer));
+        }
+
+        constexpr ErrorCode addOrSubtract(const Value& left, const Value& right, bool isSub, Value& result) {
+            if (left.isInteger && right.isInteger) {
+                long long sum = 0;
+                const bool isOverflow = isSub ? __builtin_sub_overflow(left.integer, right.integer, &sum)
+                                              : __builtin_add_overflow(left.integer, right.integer, &sum);
+                if (!isOverflow) result = toValue(sum);
+                else result = toValue(isSub ? __int128{left.integer} - right.integer
+                                            : __int128{left.integer} + right.integer);
+                return ErrorCode::None;
+            }
+            Scientific scientific;
+            const ErrorCode error = addOrSubtract(toScientific(left), toScientific(right), isSub, scientific);
+            if (error == ErrorCode::None) result = {0, scientific.value, scientific.magnitude, false};
+            return error;
+        }
+
+        constexpr ErrorCode multiplyOrDivide(const Value& left, const Value& right, bool isDiv, Value& result) {
+            if (!isDiv && left.isInteger && right.isInteger) {
+                long long product = 0;
+                if (!__builtin_mul_overflow(left.integer, right.integer, &product)) result = toValue(product);
+                else result = toValue(__int128{left.integer} * right.integer);
+                return ErrorCode::None;
+            }
+            Scientific scientific;
+            const ErrorCode error = multiplyOrDivide(toScientific(left), toScientific(right), isDiv, scientific);
+            if (error == ErrorCode::None) result = {0, scientific.value, scientific.magnitude, false};
+            return error;
+        }
+
+        constexpr Value toValue(__int128 exact) {
+            constexpr long long MAX_INTEGER = classes::Number::MAX_INTEGER;
+            if (exact >= -MAX_INTEGER && exact <= MAX_INTEGER) return {static_cast<long long>(exact), 0, 0, true};
+            const Scientific scientific = makeScientific(static_cast<double>(exact));
+            return {0, scientific.value, scientific.magnitude, false};
+        }
+
+        constexpr double roundAnswer(const Value& answer) {
+            const double value = answer.isInteger ? static_cast<double>(answer.integer) : rawValue(toScientific(answer));
+            return rawValue(makeScientific(value, MAX_DIGITS));
+        }
+
+    private:
+
+        double powers[MAX_POWER - MIN_POWER + 1] = {};
+        bool isKnown[MAX_POWER - MIN_POWER + 1] = {};
+
+        static constexpr int wrap(long long magnitude) { // to int modulo 2 ^ 32
+            return static_cast<int>(static_cast<unsigned int>(magnitude));
+        }
+
+        static constexpr bool isMagnitudeBounded(int magnitude) {
+            const auto absolute = static_cast<unsigned int>(magnitude);
+            return (magnitude < 0 ? 0U - absolute : absolute) <= MAX_MAGNITUDE;
+        }
+
+        static constexpr void split(double value, std::uint64_t& mantissa, int& binaryExponent) {
+            // value > 0 finite is mantissa * 2 ^ binaryExponent, with 2 ^ 52 <= mantissa < 2 ^ 53
+            constexpr double TWO_TO_52 = 4503599627370496.0;
+            constexpr double TWO_TO_64 = 18446744073709551616.0;
+            binaryExponent = 0;
+            for (; value >= TWO_TO_64 * TWO_TO_52; binaryExponent += 64) value /= TWO_TO_64;
+            for (; value < TWO_TO_52 / TWO_TO_64; binaryExponent -= 64) value *= TWO_TO_64;
+            for (; value >= 2 * TWO_TO_52; ++binaryExponent) value /= 2;
+            for (; value < TWO_TO_52; --binaryExponent) value *= 2;
+            mantissa = static_cast<std::uint64_t>(value);
+        }
+    };
+
+    // Lexer
+    // same tokens and errors as classes::Lexer, without variables
+    class Lexer {
+    public:
+
+        static inline constexpr char ERROR_CHAR = '\0';
+
+        constexpr explicit Lexer(std::string_view e): expression(e) {
+            for (idx = 0; idx < expression.length(); ++idx) {
+                const char c = expression[idx];
+                if (c == ' ') continue;
+                if (c == '(') ++numOpenPars;
+                if (c == '(' || c == '+' || c == '-' || isDigit(c)) current = c;
+                else if (c == '*' || c == '/') fail(ErrorCode::InvalidUnaryOperator, idx);
+                else if (c == ')') fail(ErrorCode::UnmatchedClosedParenthesis, idx);
+                else fail(ErrorCode::InvalidCharacter, idx);
+                return;
+            }
+            fail(ErrorCode::EmptyExpression, idx);
+        }
+
+        constexpr char operator*() const { return current; }
+
+        constexpr void operator++() {
+            if (error != ErrorCode::None) return;
+            if (isDelayed) {
+                isDelayed = false;
+                current = delayed;
+            }
+
+            ++idx;
+            while (idx < expression.length() && expression[idx] == ' ') ++idx;
+
+            last = current;
+            if (idx >= expression.length()) {
+                if (numOpenPars != 0) return fail(ErrorCode::UnmatchedOpenParenthesis, idx);
+                if (isOperator(last)) return fail(ErrorCode::LeadingOperator, idx);
+                current = ')';
+                return;
+            }
+
+            current = expression[idx];
+            if (isDigit(current)) {
+                if (last == ')') delay();
+            }
+            else if (current == '*' || current == '/') {
+                if (last == '(') return fail(ErrorCode::InvalidUnaryOperator, idx);
+                if (isOperator(last)) return fail(ErrorCode::AdjacentOperators, idx);
+            }
+            else if (current == '(') {
+                if (last == ')' || isDigit(last)) delay();
+                ++numOpenPars;
+            }
+            else if (current == ')') {
+                if (numOpenPars == 0) return fail(ErrorCode::UnmatchedClosedParenthesis, idx);
+                if (isOperator(last)) return fail(ErrorCode::LeadingOperator, idx);
+                if (last == '(') return fail(ErrorCode::EmptyParentheses, idx);
+                --numOpenPars;
+            }
+            else if (current != '+' && current != '-') return fail(ErrorCode::InvalidCharacter, idx);
+        }
+
+        constexpr std::string_view digits() {
+            const unsigned int begin = idx;
+            unsigned int end = idx;
+            while (end < expression.length() && isDigit(expression[end])) ++end;
+            idx = end - 1;
+            current = expression[idx];
+            operator++();
+            return expression.substr(begin, end - begin);
+        }
+
+        constexpr void fail(ErrorCode e, unsigned int offset) {
+            if (error != ErrorCode::None) return;
+            error = e;
+            errorOffset = offset;
+            current = ERROR_CHAR;
+        }
+
+        [[nodiscard]] constexpr ErrorCode getError() const { return error; }
+        [[nodiscard]] constexpr unsigned int getErrorOffset() const { return errorOffset; }
+        [[nodiscard]] constexpr unsigned int getPosition() const { return idx; }
+
+    private:
+
+        std::string_view expression;
+        unsigned int idx = 0;
+        unsigned int numOpenPars = 0;
+        bool isDelayed = false; // '*' was returned in place of delayed, like in "...+4)7-..."
+        char current = ' ';
+        char last = ' ';
+        char delayed = ' ';
+        ErrorCode error = ErrorCode::None;
+        unsigned int errorOffset = 0;
+
+        constexpr void delay() {
+            isDelayed = true;
+            delayed = current;
+            current = '*';
+        }
+    };
+
+    // Literal
+    // same rounding as classes::Literal
+    class Literal {
+    public:
+
+        static inline constexpr unsigned int MAX_EXACT_DIGITS = 19;
+
+        constexpr void append(std::string_view digits) {
+            for (const char digit : digits) {
+                if (numSignificantDigits == 0 && digit == '0') continue;
+                if (numSignificantDigits < MAX_EXACT_DIGITS)
+                    leadingDigits = leadingDigits * 10 + static_cast<unsigned long long>(digit - '0');
+                ++numSignificantDigits;
+            }
+        }
+
+        constexpr ErrorCode toValue(bool isNegative, Arithmetic& arithmetic, Value& result) const {
+            constexpr auto MAX_INTEGER = static_cast<unsigned long long>(classes::Number::MAX_INTEGER);
+            if (numSignificantDigits <= MAX_EXACT_DIGITS && leadingDigits <= MAX_INTEGER) {
+                const auto integer = static_cast<long long>(leadingDigits);
+                result = {isNegative ? -integer : integer, 0, 0, true};
+                return ErrorCode::None;
+            }
+
+            Scientific scientific;
+            if (numSignificantDigits <= MAX_EXACT_DIGITS) {
+                const auto operand = static_cast<double>(leadingDigits);
+                scientific = arithmetic.makeScientific(isNegative ? -operand : operand);
+            }
+            else {
+                constexpr unsigned int KEPT_DIGITS = MAX_DIGITS + 1;
+                const unsigned long long kept = leadingDigits / pow10(MAX_EXACT_DIGITS - KEPT_DIGITS - 1);
+                unsigned long long mantissa = kept / 10 + (kept % 10 >= 5 ? 1 : 0);
+                int magnitude = static_cast<int>(numSignificantDigits) - 1;
+                if (mantissa == pow10(KEPT_DIGITS)) {
+                    mantissa = pow10(KEPT_DIGITS - 1);
+                    ++magnitude;
+                }
+                if (magnitude > static_cast<int>(MAX_MAGNITUDE)) return ErrorCode::Overflow;
+                const double value = static_cast<double>(mantissa) / static_cast<double>(pow10(KEPT_DIGITS - 1));
+                scientific = {isNegative ? -value : value, magnitude};
+            }
+            result = {0, scientific.value, scientific.magnitude, false};
+            return ErrorCode::None;
+        }
+
+    private:
+
+        unsigned long long leadingDigits = 0;
+        unsigned int numSignificantDigits = 0;
+
+        static constexpr unsigned long long pow10(unsigned int exponent) {
+            unsigned long long power = 1;
+            for (; exponent > 0; --exponent) power *= 10;
+            return power;
+        }
+    };
+
+    // Parser
+    // same as Calculator::parseExpression(), evaluating each operation as soon as the parser builds it. Nodes of a
+    // FlatAST are evaluated in that same order, so the first error of evaluation is the same one
+    struct Frame {
+        bool isNegative = false;
+        char expressionOperator = '\0';
+        unsigned int expressionPosition = 0;
+        char termOperator = '\0';
+        unsigned int termPosition = 0;
+    };
+
+    inline constexpr Result evaluate(std::string_view expression) {
+        Arithmetic arithmetic;
+        Lexer lex(expression);
+        Frame frames[MAX_DEPTH + 1] = {};
+        Value operands[2 * MAX_DEPTH + 3] = {}; // two left operands waiting per frame, and the current one
+        std::size_t numFrames = 1;
+        std::size_t numOperands = 0;
+        Result result;
+
+        const auto apply = [&](bool isTerm, char op, unsigned int position) {
+            Value& left = operands[numOperands - 2];
+            const Value& right = operands[numOperands - 1];
+            ErrorCode error = ErrorCode::None;
+            if (result.error == ErrorCode::None) { // after an error, the values don't matter anymore
+                error = isTerm ? arithmetic.multiplyOrDivide(left, right, op == '/', left)
+                               : arithmetic.addOrSubtract(left, right, op == '-', left);
+            }
+            if (error != ErrorCode::None) {
+                result.error = error;
+                result.offset = position;
+            }
+            --numOperands;
+        };
+
+        while (true) {
+            bool isNegative = false;
+            while (true) {
+                if (*lex == '-') isNegative = !isNegative;
+                else if (*lex != '+') break;
+                ++lex;
+            }
+
+            if (*lex == '(') {
+                if (numFrames <= MAX_DEPTH) {
+                    ++lex;
+                    frames[numFrames++] = {isNegative};
+                    continue;
+                }
+                lex.fail(ErrorCode::NestingTooDeep, lex.getPosition());
+            }
+
+            const unsigned int position = lex.getPosition();
+            Literal literal;
+            while (isDigit(*lex)) literal.append(lex.digits());
+            Value operand;
+            if (literal.toValue(isNegative, arithmetic, operand) != ErrorCode::None)
+                lex.fail(ErrorCode::Overflow, position);
+            operands[numOperands++] = operand;
+
+            bool isDone = false;
+            while (true) {
+                Frame& frame = frames[numFrames - 1];
+                if (frame.termOperator != '\0') {
+                    apply(true, frame.termOperator, frame.termPosition);
+                    frame.termOperator = '\0';
+                }
+                if (*lex == '*' || *lex == '/') {
+                    frame.termOperator = *lex;
+                    frame.termPosition = lex.getPosition();
+                    ++lex;
+                    break;
+                }
+
+                if (frame.expressionOperator != '\0') {
+                    apply(false, frame.expressionOperator, frame.expressionPosition);
+                    frame.expressionOperator = '\0';
+                }
+                if (*lex == '+' || *lex == '-') {
+                    frame.expressionOperator = *lex;
+                    frame.expressionPosition = lex.getPosition();
+                    ++lex;
+                    break;
+                }
+
+                if (numFrames == 1) {
+                    isDone = true;
+                    break;
+                }
+                ++lex;
+                const bool isNegated = frame.isNegative;
+                --numFrames;
+                if (isNegated) {
+                    Value& value = operands[numOperands - 1];
+                    if (value.isInteger) value.integer = -value.integer;
+                    else value.value = -value.value;
+                }
+            }
+            if (isDone) break;
+        }
+
+        if (lex.getError() != ErrorCode::None) {
+            result.error = lex.getError();
+            result.offset = lex.getErrorOffset();
+        }
+        if (result) result.answer = arithmetic.roundAnswer(operands[0]);
+        return result;
+    }
+
+}
+
+namespace calc {
+
+    inline constexpr Result tryEval(std::string_view expression) { return compile_time::evaluate(expression); }
+    // same result as Calculator::tryCalculate()
+
+    inline constexpr double eval(std::string_view expression) {
+        // same as Calculator::calculate(). An error throws, which isn't a constant expression, so the compiler rejects
+        // invalid expressions given to it
+        const Result result = compile_time::evaluate(expression);
+        if (!result) utils::throwError(result.error);
+        return result.answer;
+    }
+
+}
+
+#endif //COMPILE_TIME_H
@@ -0,0 +1,349 @@
+#include "calculator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// Decimal Backend
+// only built with the CALC_DECIMAL_BACKEND option
+namespace {
+	using Coefficient = unsigned __int128;
+
+	constexpr unsigned int KEPT_DIGITS = calc::DECIMAL_DIGITS + 1; // digits kept by every operation
+	static_assert(calc::DECIMAL_DIGITS <= 36, "coefficients times 10 have to fit in 128 bits");
+
+	constexpr std::uint64_t POWERS_OF_TEN[] = {
+		1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL,
+		10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+		1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL, 1000000000000000000ULL,
+		10000000000000000000ULL
+	};
+
+	Coefficient coefficientPower(unsigned int exponent) { // exponent <= 38
+		Coefficient power = 1;
+		for (; exponent >= 19; exponent -= 19) power *= POWERS_OF_TEN[19];
+		return power * POWERS_OF_TEN[exponent];
+	}
+
+	unsigned int countDigits(std::uint64_t value) {
+		unsigned int numDigits = 1;
+		while (numDigits < 20 && value >= POWERS_OF_TEN[numDigits]) ++numDigits;
+		return numDigits;
+	}
+
+	// Wide
+	// exact result of an operation before it gets rounded: an integer in base 10 ^ 19, least significant limb first.
+	// Sums are the largest: two coefficients aligned to the smaller exponent take up to 2 * KEPT_DIGITS + 2 digits
+	constexpr std::uint64_t LIMB_BASE = POWERS_OF_TEN[19];
+	constexpr unsigned int LIMB_DIGITS = 19;
+	constexpr unsigned int NUM_LIMBS = 5;
+
+	struct Wide {
+		std::uint64_t limbs[NUM_LIMBS] = {};
+	};
+
+	void addAt(Wide& wide, unsigned int limb, Coefficient value) { // value < LIMB_BASE ^ 2
+		for (; value != 0; ++limb) {
+			if (limb >= NUM_LIMBS) throw std::logic_error("Wide overflow in decimal backend");
+			value += wide.limbs[limb];
+			wide.limbs[limb] = static_cast<std::uint64_t>(value % LIMB_BASE);
+			value /= LIMB_BASE;
+		}
+	}
+
+	Wide toWide(Coefficient coefficient, unsigned int shift) { // coefficient * 10 ^ shift
+		Wide wide;
+		const unsigned int limb = shift / LIMB_DIGITS;
+		const std::uint64_t factor = POWERS_OF_TEN[shift % LIMB_DIGITS];
+		// coefficient < LIMB_BASE ^ 2, so both of its limbs times factor are under LIMB_BASE ^ 2 too
+		addAt(wide, limb, static_cast<Coefficient>(static_cast<std::uint64_t>(coefficient % LIMB_BASE)) * factor);
+		addAt(wide, limb + 1, static_cast<Coefficient>(static_cast<std::uint64_t>(coefficient / LIMB_BASE)) * factor);
+		return wide;
+	}
+
+	Wide multiply(Coefficient left, Coefficient right) {
+		const std::uint64_t leftLimbs[] = {static_cast<std::uint64_t>(left % LIMB_BASE),
+		                                   static_cast<std::uint64_t>(left / LIMB_BASE)};
+		const std::uint64_t rightLimbs[] = {static_cast<std::uint64_t>(right % LIMB_BASE),
+		                                    static_cast<std::uint64_t>(right / LIMB_BASE)};
+		Wide product;
+		for (unsigned int i = 0; i < 2; ++i)
+			for (unsigned int j = 0; j < 2; ++j)
+				addAt(product, i + j, static_cast<Coefficient>(leftLimbs[i]) * rightLimbs[j]);
+		return product;
+	}
+
+	int compare(const Wide& left, const Wide& right) {
+		for (unsigned int limb = NUM_LIMBS; limb-- > 0;)
+			if (left.limbs[limb] != right.limbs[limb]) return left.limbs[limb] < right.limbs[limb] ? -1 : 1;
+		return 0;
+	}
+
+	void add(Wide& left, const Wide& right) {
+		for (unsigned int limb = 0; limb < NUM_LIMBS; ++limb) addAt(left, limb, right.limbs[limb]);
+	}
+
+	void subtract(Wide& left, const Wide& right) { // left >= right
+		std::uint64_t borrow = 0;
+		for (unsigned int limb = 0; limb < NUM_LIMBS; ++limb) {
+			const std::uint64_t subtrahend = right.limbs[limb] + borrow;
+			borrow = left.limbs[limb] < subtrahend ? 1 : 0;
+			left.limbs[limb] = left.limbs[limb] + borrow * LIMB_BASE - subtrahend;
+		}
+	}
+
+	std::uint64_t divide(Wide& wide, std::uint64_t divisor) { // returns the remainder
+		Coefficient remainder = 0;
+		for (unsigned int limb = NUM_LIMBS; limb-- > 0;) {
+			const Coefficient current = remainder * LIMB_BASE + wide.limbs[limb];
+			wide.limbs[limb] = static_cast<std::uint64_t>(current / divisor);
+			remainder = current % divisor;
+		}
+		return static_cast<std::uint64_t>(remainder);
+	}
+
+	unsigned int countDigits(const Wide& wide) { // 0 has 1 digit
+		unsigned int limb = NUM_LIMBS - 1;
+		while (limb > 0 && wide.limbs[limb] == 0) --limb;
+		return limb * LIMB_DIGITS + countDigits(wide.limbs[limb]);
+	}
+
+	bool isZero(const Wide& wide) { return countDigits(wide) == 1 && wide.limbs[0] == 0; }
+
+	calc::classes::Decimal roundWide(Wide wide, int exponent, bool isNegative, unsigned int numDigits) {
+		// only the first dropped digit decides the rounding, since halves are rounded away from zero
+		const unsigned int numDigitsBefore = countDigits(wide);
+		if (numDigitsBefore > numDigits) {
+			for (unsigned int dropped = numDigitsBefore - numDigits - 1; dropped > 0;) {
+				const unsigned int step = std::min(dropped, LIMB_DIGITS);
+				divide(wide, POWERS_OF_TEN[step]);
+				dropped -= step;
+			}
+			const bool isRoundedUp = divide(wide, 10) >= 5;
+			exponent += static_cast<int>(numDigitsBefore - numDigits);
+			if (isRoundedUp) addAt(wide, 0, 1);
+			if (countDigits(wide) > numDigits) { // rounded up to a power of ten
+				divide(wide, 10);
+				++exponent;
+			}
+		}
+		if (isZero(wide)) return {};
+		const Coefficient coefficient = static_cast<Coefficient>(wide.limbs[1]) * LIMB_BASE + wide.limbs[0];
+		return {coefficient, exponent, isNegative};
+	}
+
+	bool isMagnitudeBounded(int magnitude) {
+		return static_cast<unsigned int>(std::abs(magnitude)) <= calc::MAX_MAGNITUDE;
+	}
+}
+
+int calc::classes::Decimal::magnitude() const {
+	if (coefficient == 0) return 0;
+	return exponent + static_cast<int>(countDigits(toWide(coefficient, 0))) - 1;
+}
+
+calc::classes::Decimal calc::classes::Decimal::rounded(unsigned int numDigits) const {
+	return roundWide(toWide(coefficient, 0), exponent, isNegative, numDigits);
+}
+
+std::string calc::classes::Decimal::toString(unsigned int numDigits) const {
+	const Decimal value = rounded(numDigits);
+	if (value.coefficient == 0) return "0";
+
+	std::string digits;
+	for (Coefficient c = value.coefficient; c != 0; c /= 10) digits += static_cast<char>('0' + c % 10);
+	std::reverse(digits.begin(), digits.end());
+	const int magnitude = value.magnitude();
+	while (digits.size() > 1 && digits.back() == '0') digits.pop_back();
+
+	std::string text = value.isNegative ? "-" : "";
+	if (magnitude < -4 || magnitude >= static_cast<int>(numDigits)) { // scientific notation, same rule as %g
+		text += digits[0];
+		if (digits.size() > 1) text += '.' + digits.substr(1);
+		text += magnitude < 0 ? "e-" : "e+";
+		const std::string exponentDigits = std::to_string(std::abs(magnitude));
+		if (exponentDigits.size() < 2) text += '0';
+		return text + exponentDigits;
+	}
+
+	if (magnitude < 0) return text + "0." + std::string(static_cast<std::size_t>(-magnitude - 1), '0') + digits;
+	const auto numIntegerDigits = static_cast<std::size_t>(magnitude) + 1;
+	if (digits.size() <= numIntegerDigits) return text + digits + std::string(numIntegerDigits - digits.size(), '0');
+	return text + digits.substr(0, numIntegerDigits) + '.' + digits.substr(numIntegerDigits);
+}
+
+calc::ErrorCode calc::utils::addOrSubtract(
+	const classes::Decimal& left, const classes::Decimal& right, bool isSub, classes::Decimal& result) {
+	classes::Decimal big = left;
+	classes::Decimal small = right;
+	if (isSub) small.isNegative = !small.isNegative;
+	if (small.coefficient == 0 || big.coefficient == 0) { // also keeps 0 from being given a magnitude below
+		result = big.coefficient == 0 ? small : big;
+		if (result.coefficient == 0) result = {};
+		return isMagnitudeBounded(result.magnitude()) ? ErrorCode::None : ErrorCode::Overflow;
+	}
+	if (big.magnitude() < small.magnitude()) std::swap(big, small);
+
+	// a value entirely below the first dropped digit of the sum can't change the sum's rounding or its magnitude, only
+	// whether the digits above are reached by a carry or a borrow. Any such value gives the same rounded sum, so it is
+	// replaced with one that doesn't need as many digits to be aligned with the other value
+	const int stickyMagnitude = big.magnitude() - static_cast<int>(KEPT_DIGITS) - 2;
+	if (small.magnitude() < stickyMagnitude) small = {1, stickyMagnitude - 1, small.isNegative};
+
+	const int exponent = std::min(big.exponent, small.exponent);
+	Wide sum = toWide(big.coefficient, static_cast<unsigned int>(big.exponent - exponent));
+	const Wide other = toWide(small.coefficient, static_cast<unsigned int>(small.exponent - exponent));
+	bool isNegative = big.isNegative;
+	if (big.isNegative == small.isNegative) add(sum, other);
+	else if (compare(sum, other) >= 0) subtract(sum, other);
+	else {
+		Wide difference = other;
+		subtract(difference, sum);
+		sum = difference;
+		isNegative = small.isNegative;
+	}
+
+	if (isZero(sum)) {
+		result = {};
+		return ErrorCode::None;
+	}
+	if (!isMagnitudeBounded(exponent + static_cast<int>(countDigits(sum)) - 1))
+		return ErrorCode::Overflow;
+
+	result = roundWide(sum, exponent, isNegative, KEPT_DIGITS);
+	return ErrorCode::None;
+}
+
+calc::ErrorCode calc::utils::multiplyOrDivide(
+	const classes::Decimal& left, const classes::Decimal& right, bool isDiv, classes::Decimal& result) {
+	const bool isNegative = left.isNegative != right.isNegative;
+	if (isDiv) {
+		if (right.coefficient == 0)
+			return ErrorCode::DivisionByZero;
+
+		if (!isProductBounded(left.magnitude(), -right.magnitude()))
+			return ErrorCode::Overflow;
+
+		// long division, one digit past KEPT_DIGITS to round with. The remainder is below right.coefficient, so it
+		// still fits in 128 bits once multiplied by 10
+		Coefficient quotient = left.coefficient / right.coefficient;
+		Coefficient remainder = left.coefficient % right.coefficient;
+		int exponent = left.exponent - right.exponent;
+		while (remainder != 0 && quotient < coefficientPower(KEPT_DIGITS)) {
+			remainder *= 10;
+			quotient = quotient * 10 + remainder / right.coefficient;
+			remainder %= right.coefficient;
+			--exponent;
+		}
+		result = roundWide(toWide(quotient, 0), exponent, isNegative, KEPT_DIGITS);
+		return ErrorCode::None;
+	}
+
+
+	if (!isProductBounded(left.magnitude(), right.magnitude()))
+		return ErrorCode::Overflow;
+
+	result = roundWide(multiply(left.coefficient, right.coefficient), left.exponent + right.exponent, isNegative,
+	               KEPT_DIGITS);
+	return ErrorCode::None;
+}
+
+
+// Decimal Literal
+void calc::classes::DecimalLiteral::append(std::string_view digits) {
+	std::size_t i = 0;
+	if (numSignificantDigits == 0)
+		while (i < digits.size() && digits[i] == '0') ++i;
+
+	for (; i < digits.size() && numSignificantDigits < MAX_EXACT_DIGITS; ++i, ++numSignificantDigits)
+		leadingDigits = leadingDigits * 10 + static_cast<unsigned int>(digits[i] - '0');
+
+	numSignificantDigits += static_cast<unsigned int>(digits.size() - i); // only counted past MAX_EXACT_DIGITS
+}
+
+calc::ErrorCode calc::classes::DecimalLiteral::toScientific(bool isNegative, Decimal& result) const {
+	// leadingDigits has one digit more than is kept, which is all that rounding half away from zero needs
+	const unsigned int numDigits = std::min(numSignificantDigits, MAX_EXACT_DIGITS);
+	const auto numDroppedDigits = static_cast<int>(numSignificantDigits - numDigits);
+	const Decimal value = roundWide(toWide(leadingDigits, 0), numDroppedDigits, isNegative, KEPT_DIGITS);
+	if (value.magnitude() > static_cast<int>(MAX_MAGNITUDE)) return ErrorCode::Overflow;
+
+	result = value;
+	return ErrorCode::None;
+}
+
+
+// Decimal AST
+calc::classes::DecimalAST::Node calc::classes::DecimalAST::append(
+	NodeType type, Node left, Node right, unsigned int position) {
+	nodes.push_back({type, left, right, position, {}});
+	return root();
+}
+
+calc::classes::DecimalAST::Node calc::classes::DecimalAST::value(const Decimal& val) {
+	nodes.push_back({NodeType::Value, 0, 0, 0, val});
+	return root();
+}
+
+calc::classes::DecimalAST::Node calc::classes::DecimalAST::negation(Node operand) {
+	return append(NodeType::Negation, operand, 0, 0);
+}
+
+calc::classes::DecimalAST::Node calc::classes::DecimalAST::addOrSubtract(
+	Node left, Node right, bool isSub, unsigned int position) {
+	return append(isSub ? NodeType::Subtract : NodeType::Add, left, right, position);
+}
+
+calc::classes::DecimalAST::Node calc::classes::DecimalAST::multiplyOrDivide(
+	Node left, Node right, bool isDiv, unsigned int position) {
+	return append(isDiv ? NodeType::Divide : NodeType::Multiply, left, right, position);
+}
+
+calc::ErrorCode calc::classes::DecimalAST::tryEvaluate(Decimal& answer, unsigned int& errorOffset) const {
+	// one pass over the nodes with a stack of values, like FlatAST::tryEvaluate()
+	thread_local std::vector<Decimal> stack;
+	stack.clear();
+	for (const DecimalNode& node : nodes) {
+		if (node.type == NodeType::Value) {
+			stack.push_back(node.value);
+			continue;
+		}
+		if (node.type == NodeType::Negation) {
+			Decimal& operand = stack.back();
+			if (operand.coefficient != 0) operand.isNegative = !operand.isNegative;
+			continue;
+		}
+
+		const Decimal right_val = stack.back();
+		stack.pop_back();
+		const Decimal left_val = stack.back();
+		ErrorCode error;
+		switch (node.type) {
+		case NodeType::Add:
+		case NodeType::Subtract:
+			error = utils::addOrSubtract(left_val, right_val, node.type == NodeType::Subtract, stack.back());
+			break;
+
+		case NodeType::Multiply:
+		case NodeType::Divide:
+			error = utils::multiplyOrDivide(left_val, right_val, node.type == NodeType::Divide, stack.back());
+			break;
+
+		default: throw std::logic_error("Unexpected node type in DecimalAST::tryEvaluate method");
+		}
+
+		if (error != ErrorCode::None) {
+			errorOffset = node.position;
+			return error;
+		}
+	}
+
+	if (stack.size() != 1) throw std::logic_error("Unbalanced stack in DecimalAST::tryEvaluate method");
+	answer = stack[0];
+	return ErrorCode::None;
+}
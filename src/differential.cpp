@@ -0,0 +1,76 @@
+#include "differential.h"
+#include "compile_time.h"
+#include "columnar.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace {
+	std::string describeAnswer(double answer) {
+		if (answer != answer) return "nan"; // whatever its sign and payload
+		char buffer[32];
+		std::snprintf(buffer, sizeof(buffer), "%.17g", answer); // enough digits to tell every other double apart
+		return buffer;
+	}
+
+	// engines that throw only give the answer or the error's message, which is all they are compared by
+	template <typename Engine>
+	std::string describeThrowing(Engine&& engine) {
+		try { return describeAnswer(engine()); }
+		catch (const std::exception& e) { return e.what(); }
+	}
+}
+
+std::string calc::differential::describe(const Result& result) {
+	if (result) return describeAnswer(result.answer);
+	return result.message() + " at offset " + std::to_string(result.offset);
+}
+
+calc::differential::Checker::Checker(): engine(64) {
+	sharingCalculator.enableSharing(true);
+	cachingCalculator.enableCache(64);
+}
+
+std::vector<calc::differential::Mismatch> calc::differential::Checker::check(std::string_view expression) {
+	std::vector<Mismatch> mismatches;
+	const Result expected = tryEval(expression);
+
+	const std::string expectedDescription = describe(expected);
+	const std::string expectedOutcome = expected ? expectedDescription : expected.message(); // without the offset
+	const auto compare = [&](const char* name, const Result& actual) {
+		const std::string description = describe(actual);
+		if (description != expectedDescription) mismatches.push_back({name, expectedDescription, description});
+	};
+	const auto compareThrowing = [&](const char* name, const std::string& outcome) {
+		if (outcome != expectedOutcome) mismatches.push_back({name, expectedOutcome, outcome});
+	};
+
+	compare("tryCalculate", calculator.tryCalculate(expression));
+	compareThrowing("calculate", describeThrowing([&] { return calculator.calculate(expression); }));
+	compare("calculateBatch", calculator.calculateBatch({expression})[0]);
+	compare("sharing", sharingCalculator.tryCalculate(expression));
+	(void) cachingCalculator.tryCalculate(expression);
+	compare("cache", cachingCalculator.tryCalculate(expression));
+	compare("Engine", engine.evaluate(expression));
+	compareThrowing("Program", describeThrowing([&] { return calculator.execute(Calculator::compile(expression)); }));
+
+	if (std::any_of(expression.begin(), expression.end(), [](char c) { return utils::isLetter(c); }))
+		return mismatches;
+	compareThrowing("Formula", describeThrowing([&] {
+		const Result result = Calculator::compile(expression, variables).evaluate();
+		if (!result) utils::throwError(result.error);
+		return result.answer;
+	}));
+	compareThrowing("ColumnarFormula", describeThrowing([&] {
+		Result result;
+		Calculator::compileColumnar(expression).evaluate({}, 1, &result);
+		if (!result) utils::throwError(result.error);
+		return result.answer;
+	}));
+	return mismatches;
+}
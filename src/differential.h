@@ -0,0 +1,50 @@
+#ifndef DIFFERENTIAL_H
+#define DIFFERENTIAL_H
+
+#include "calculator.h"
+#include "engine.h"
+#include "formula.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// Differential Checking
+// runs one expression through every engine and compares each result with the reference's: the evaluator of
+// compile_time.h, whose lexer, parser and arithmetic are written apart from the others, with none of their fast
+// paths. Engines returning a Result must give the same answer, error and offset, and the ones that throw (calculate(),
+// compile() and execute()) the same answer or error. Formulas parse letters as variables, so they are only checked
+// on expressions without any. Answers are compared bit for bit, except that all NaNs are the same.
+// Used by the fuzz target (fuzz.cpp) and the differential harness (differential_harness.cpp)
+namespace calc::differential {
+
+    struct Mismatch {
+        const char* engine;
+        std::string expected; // described by describe(), from the reference
+        std::string actual;
+    };
+
+    [[nodiscard]] std::string describe(const Result& result); // answer with 17 digits, or error message and offset
+
+    // not safe to share between threads, since each engine keeps its scratch space from one check to the next
+    class Checker {
+    public:
+
+        Checker();
+
+        [[nodiscard]] std::vector<Mismatch> check(std::string_view expression);
+        // every engine that disagrees with the reference, in a fixed order. Empty when they all agree
+
+    private:
+
+        Calculator calculator;
+        Calculator sharingCalculator;
+        Calculator cachingCalculator; // gets every expression twice, so that the second result comes from its cache
+        Engine engine;
+        VariableTable variables; // empty, expressions with variables being left out
+    };
+
+}
+
+#endif //DIFFERENTIAL_H
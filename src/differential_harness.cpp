@@ -0,0 +1,191 @@
+#include "differential.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Runs generated expressions, valid ones and ones broken in every way the lexer and parser check for, through every
+// engine and compares their results with the reference's, see differential.h. Then times the main engines on a
+// sample of them, each repeated into two longer expressions 16 times apart in length, and flags the ones taking more
+// than MAX_GROWTH times longer per byte at the longer length, whose latency grows faster than their length.
+// Expressions are generated from the seed, so a failure can be reproduced with the same arguments.
+// Exits with 1 when any engine disagrees or any latency is super-linear.
+// Usage: calculator_diff [--seed <number>] [--count <expressions>] [--latency-samples <expressions>]
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr double MAX_GROWTH = 4;
+    constexpr std::size_t MAX_PRINTED = 20; // of each kind of failure
+
+    class Generator {
+    public:
+        explicit Generator(std::uint64_t seed): random(seed) {}
+
+        unsigned int below(unsigned int bound) {
+            return std::uniform_int_distribution<unsigned int>(0, bound - 1)(random);
+        }
+
+        // digits with the occasional leading zeros and decimal point, now and then as many as the bounds allow
+        std::string literal() {
+            std::string digits;
+            if (below(8) == 0) digits.append(1 + below(3), '0');
+            const unsigned int numDigits = below(16) == 0 ? 290 + below(20) : 1 + below(below(4) == 0 ? 25 : 4);
+            for (unsigned int i = 0; i < numDigits; ++i) digits += static_cast<char>('0' + below(10));
+            if (below(6) == 0) digits.insert(below(static_cast<unsigned int>(digits.size()) + 1), 1, '.');
+            return digits;
+        }
+
+        // an operand is a literal or a parenthesized expression, after a chain of signs
+        std::string operand(unsigned int depth) {
+            std::string out;
+            for (unsigned int i = below(8) == 0 ? 1 + below(4) : 0; i > 0; --i) out += "-+"[below(2)];
+            if (depth < 6 && below(4) == 0) out += '(' + expression(depth + 1) + ')';
+            else out += literal();
+            return out;
+        }
+
+        std::string expression(unsigned int depth = 0) {
+            std::string out = operand(depth);
+            for (unsigned int i = below(5); i > 0; --i) {
+                if (below(6) == 0) out += ' ';
+                out += "+-*/"[below(4)];
+                if (below(6) == 0) out += ' ';
+                out += operand(depth);
+            }
+            return out;
+        }
+
+        // half of the expressions get a few random edits, mostly with the characters the lexer treats specially
+        std::string next() {
+            std::string out = expression();
+            if (below(2) == 0) return out;
+            static constexpr std::string_view CHARACTERS = "0123456789+-*/().. ()x#\t";
+            for (unsigned int i = 1 + below(3); i > 0; --i) {
+                const auto at = below(static_cast<unsigned int>(out.size()) + 1);
+                switch (below(4)) {
+                case 0: out.insert(at, 1, CHARACTERS[below(static_cast<unsigned int>(CHARACTERS.size()))]); break;
+                case 1: if (at < out.size()) out.erase(at, 1); break;
+                case 2: if (at < out.size()) out[at] = CHARACTERS[below(static_cast<unsigned int>(CHARACTERS.size()))];
+                        break;
+                default: out.insert(at, out.substr(below(static_cast<unsigned int>(out.size()) + 1), 1 + below(6)));
+                }
+            }
+            return out;
+        }
+
+    private:
+        std::mt19937_64 random;
+    };
+
+    volatile double sink; // keeps the results of the timed calls alive
+
+    // shortest time of a few rounds, each long enough for the clock, so that one interruption doesn't count
+    template <typename Call>
+    double nsPerByte(const std::string& expression, Call&& call) {
+        double best = 1e300;
+        for (int round = 0; round < 3; ++round) {
+            std::size_t numCalls = 0;
+            const Clock::time_point start = Clock::now();
+            double elapsed = 0;
+            do {
+                sink = call(expression);
+                ++numCalls;
+                elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            } while (elapsed < 1e6);
+            best = std::min(best, elapsed / static_cast<double>(numCalls));
+        }
+        return best / static_cast<double>(expression.size());
+    }
+
+    // copies of expression joined by +, with isNested each one in parentheses inside the one before. Every copy then
+    // adds the same work, so only a super-linear engine takes longer per byte with more of them
+    std::string repeat(const std::string& expression, unsigned int numCopies, bool isNested) {
+        std::string out = expression;
+        for (unsigned int i = 1; i < numCopies; ++i) out += (isNested ? "+(" : "+") + expression;
+        if (isNested) out.append(numCopies - 1, ')');
+        return out;
+    }
+
+    double calculate(Calculator& calculator, const std::string& expression) {
+        return calculator.tryCalculate(expression).answer;
+    }
+
+    double compile(Calculator&, const std::string& expression) {
+        try { return static_cast<double>(Calculator::compile(expression).instructions().size()); }
+        catch (const std::exception&) { return 0; }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::uint64_t seed = 42;
+    std::size_t numExpressions = 100000;
+    std::size_t numLatencySamples = 100;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view argument = argv[i];
+        if (argument == "--seed" && i + 1 < argc) seed = std::strtoull(argv[++i], nullptr, 10);
+        else if (argument == "--count" && i + 1 < argc) numExpressions = std::strtoull(argv[++i], nullptr, 10);
+        else if (argument == "--latency-samples" && i + 1 < argc)
+            numLatencySamples = std::strtoull(argv[++i], nullptr, 10);
+        else {
+            std::fprintf(stderr, "Usage: %s [--seed <number>] [--count <expressions>] "
+                                 "[--latency-samples <expressions>]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Generator generator(seed);
+    calc::differential::Checker checker;
+    std::vector<std::string> samples;
+    std::size_t numMismatches = 0;
+    for (std::size_t i = 0; i < numExpressions; ++i) {
+        const std::string expression = generator.next();
+        if (samples.size() < numLatencySamples && i % (numExpressions / (numLatencySamples + 1) + 1) == 0)
+            samples.push_back(expression);
+        const std::vector<calc::differential::Mismatch> mismatches = checker.check(expression);
+        if (mismatches.empty() || ++numMismatches > MAX_PRINTED) continue;
+        std::printf("Mismatch for \"%s\"\n", expression.c_str());
+        for (const calc::differential::Mismatch& mismatch : mismatches)
+            std::printf("    %s: %s instead of %s\n", mismatch.engine, mismatch.actual.c_str(),
+                        mismatch.expected.c_str());
+    }
+    std::printf("Mismatches: %zu of %zu expressions\n", numMismatches, numExpressions);
+
+    Calculator calculator;
+    Calculator sharingCalculator;
+    sharingCalculator.enableSharing(true);
+    struct Timed {
+        const char* engine;
+        Calculator& calculator;
+        double (*call)(Calculator&, const std::string&);
+    };
+    const Timed timed[] = {{"tryCalculate", calculator, calculate}, {"sharing", sharingCalculator, calculate},
+                           {"compile", calculator, compile}};
+    std::size_t numSuperLinear = 0;
+    std::size_t numMeasurements = 0;
+    for (const std::string& sample : samples) {
+        for (const bool isNested : {false, true}) {
+            const std::string shorter = repeat(sample, 4, isNested);
+            const std::string longer = repeat(sample, 64, isNested);
+            for (const Timed& t : timed) {
+                const auto call = [&](const std::string& expression) { return t.call(t.calculator, expression); };
+                const double growth = nsPerByte(longer, call) / nsPerByte(shorter, call);
+                ++numMeasurements;
+                if (growth <= MAX_GROWTH || ++numSuperLinear > MAX_PRINTED) continue;
+                std::printf("Super-linear latency of %s, %.1f times longer per byte at %zu bytes than at %zu, for %s "
+                            "copies of \"%s\"\n", t.engine, growth, longer.size(), shorter.size(),
+                            isNested ? "nested" : "added", sample.c_str());
+            }
+        }
+    }
+    std::printf("Super-linear latencies: %zu of %zu measurements\n", numSuperLinear, numMeasurements);
+
+    return numMismatches == 0 && numSuperLinear == 0 ? 0 : 1;
+}
@@ -0,0 +1,40 @@
+#include "engine.h"
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+
+// Engine
+calc::Engine::Engine(std::size_t cacheCapacity) {
+	if (cacheCapacity != 0) cache = std::make_unique<StripedResultCache>(cacheCapacity);
+}
+
+calc::Result calc::Engine::evaluate(std::string_view expression) const {
+	thread_local classes::FlatAST tree; // every thread parses into its own tree
+	return cache ? cache->evaluate(expression, tree) : Calculator::evaluate(expression, tree);
+}
+
+std::vector<calc::Result> calc::Engine::evaluateBatch(const std::vector<std::string_view>& expressions) const {
+	std::vector<Result> results(expressions.size());
+	for (std::size_t i = 0; i < expressions.size(); ++i) results[i] = evaluate(expressions[i]);
+	return results;
+}
+
+
+// Session
+double calc::Session::calculate(std::string_view expression) {
+	const Result result = tryCalculate(expression);
+	if (!result) utils::throwError(result.error);
+	return result.answer;
+}
+
+calc::Result calc::Session::tryCalculate(std::string_view expression) {
+	const Result result = engine->evaluate(expression);
+	if (result) {
+		lastAnswer = result.answer;
+		lastExpression = expression;
+	}
+	return result;
+}
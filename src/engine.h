@@ -0,0 +1,66 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "calculator.h"
+#include "result_cache.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// Engine and Sessions
+// Calculator keeps the last expression and answer of every calculation, so one instance can't be shared between
+// threads. An Engine has no such state: its member functions are const and safe to call from any number of threads at
+// once, and one Engine, with its cache, can serve a whole process. The history lives in a Session instead, one per
+// user or connection, which only holds the last expression and answer
+namespace calc {
+
+    class Engine {
+    public:
+
+        explicit Engine(std::size_t cacheCapacity = 0);
+        // results of the cacheCapacity most recently used expressions are shared by every thread, see
+        // StripedResultCache. 0 disables the cache
+
+        Engine(const Engine&) = delete;
+        Engine& operator=(const Engine&) = delete;
+
+        [[nodiscard]] Result evaluate(std::string_view expression) const;
+        // same result as Calculator::tryCalculate(). Every thread parses into its own tree, kept from one call to the
+        // next, so evaluating stops allocating once each thread's tree has grown enough
+
+        [[nodiscard]] std::vector<Result> evaluateBatch(const std::vector<std::string_view>& expressions) const;
+
+        [[nodiscard]] const StripedResultCache* getCache() const { return cache.get(); } // nullptr when disabled
+
+    private:
+
+        std::unique_ptr<StripedResultCache> cache; // locks internally, so const member functions can use it
+    };
+
+    // not safe to share between threads, but cheap enough to create one per connection. The engine needs to outlive it
+    class Session {
+    public:
+
+        explicit Session(const Engine& e): engine(&e) {}
+
+        double calculate(std::string_view expression); // same as Calculator::calculate()
+
+        Result tryCalculate(std::string_view expression); // same as Calculator::tryCalculate()
+
+        [[nodiscard]] const std::string& getLastExpression() const { return lastExpression; }
+        [[nodiscard]] double getLastAnswer() const { return lastAnswer; }
+
+    private:
+
+        const Engine* engine;
+        std::string lastExpression = "0";
+        double lastAnswer = 0;
+    };
+
+}
+
+#endif //ENGINE_H
@@ -0,0 +1,118 @@
+#include "calculator.h"
+#include "format.h"
+#include "parallel_calculator.h"
+
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Evaluates a file with one expression per line and writes one answer or error per line to another file, in the same
+// order. The input is memory-mapped and the lines are evaluated where they are, LINES_PER_WINDOW at a time.
+// Usage: calculator_file <input file> <output file> [number of threads]
+
+namespace {
+    constexpr std::size_t LINES_PER_WINDOW = 1 << 16;
+
+    // false unless all of text is a number in the range of value, so that "4x", "-1" or "" aren't taken for one
+    bool parseNumber(const char* text, unsigned int& value) {
+        const char* end = text + std::strlen(text);
+        const auto [last, error] = std::from_chars(text, end, value);
+        return error == std::errc() && last == end;
+    }
+
+    class MappedFile {
+    public:
+        explicit MappedFile(const char* path) {
+            fd = ::open(path, O_RDONLY);
+            if (fd < 0) return;
+            struct stat info{};
+            if (::fstat(fd, &info) != 0) return;
+            size = static_cast<std::size_t>(info.st_size);
+            if (size == 0) { isValid = true; return; }
+            void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) return;
+            ::madvise(mapping, size, MADV_SEQUENTIAL);
+            data = static_cast<const char*>(mapping);
+            isValid = true;
+        }
+
+        ~MappedFile() {
+            if (data != nullptr) ::munmap(const_cast<char*>(data), size);
+            if (fd >= 0) ::close(fd);
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        [[nodiscard]] bool valid() const { return isValid; }
+        [[nodiscard]] std::string_view contents() const { return {data, size}; }
+
+    private:
+        int fd = -1;
+        const char* data = nullptr;
+        std::size_t size = 0;
+        bool isValid = false;
+    };
+}
+
+int main(int argc, char* argv[]) {
+    unsigned int numThreads = std::thread::hardware_concurrency();
+    if (argc < 3 || argc > 4 || (argc == 4 && !parseNumber(argv[3], numThreads))) {
+        std::fprintf(stderr, "Usage: %s <input file> <output file> [number of threads]\n", argv[0]);
+        return 2;
+    }
+
+    const MappedFile input(argv[1]);
+    if (!input.valid()) {
+        std::perror(argv[1]);
+        return 1;
+    }
+
+    std::FILE* output = std::fopen(argv[2], "wb");
+    if (output == nullptr) {
+        std::perror(argv[2]);
+        return 1;
+    }
+
+    ParallelCalculator calc(numThreads);
+
+    std::vector<std::string_view> lines;
+    lines.reserve(LINES_PER_WINDOW);
+    std::string buffer;
+
+    const std::string_view contents = input.contents();
+    std::size_t begin = 0;
+    while (begin < contents.size()) {
+        lines.clear();
+        while (begin < contents.size() && lines.size() < LINES_PER_WINDOW) {
+            std::size_t end = contents.find('\n', begin);
+            if (end == std::string_view::npos) end = contents.size();
+            std::string_view line = contents.substr(begin, end - begin);
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            lines.push_back(line);
+            begin = end + 1;
+        }
+
+        buffer.clear();
+        calc::appendResults(calc.calculateBatch(lines), buffer, "ERROR / INVALID INPUT : ");
+        if (std::fwrite(buffer.data(), 1, buffer.size(), output) != buffer.size()) {
+            std::perror(argv[2]);
+            std::fclose(output);
+            return 1;
+        }
+    }
+
+    if (std::fclose(output) != 0) {
+        std::perror(argv[2]);
+        return 1;
+    }
+}
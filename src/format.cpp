@@ -0,0 +1,58 @@
+#include "format.h"
+
+#include <charconv>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// Formatting
+namespace {
+	struct ErrorMessages { // formatted once, instead of once per error
+		std::string messages[static_cast<std::size_t>(calc::ErrorCode::DivisionByZero) + 1];
+
+		ErrorMessages() {
+			for (std::size_t e = 1; e < std::size(messages); ++e)
+				messages[e] = calc::errorMessage(static_cast<calc::ErrorCode>(e));
+		}
+
+		const std::string& operator[](calc::ErrorCode error) const { return messages[static_cast<std::size_t>(error)]; }
+	};
+
+	const ErrorMessages& getErrorMessages() {
+		static const ErrorMessages messages;
+		return messages;
+	}
+}
+
+const std::string& calc::formattedErrorMessage(ErrorCode error) {
+	return getErrorMessages()[error];
+}
+
+std::to_chars_result calc::formatAnswer(char* first, char* last, double answer, AnswerFormat format) {
+	// the precision of std::chars_format::general follows printf's "%g", which std::ostream uses too
+	if (format == AnswerFormat::Shortest) return std::to_chars(first, last, answer);
+	return std::to_chars(first, last, answer, std::chars_format::general, static_cast<int>(MAX_DIGITS));
+}
+
+std::to_chars_result calc::formatAnswer(
+	char* first, char* last, const classes::ScientificValue& answer, AnswerFormat format) {
+	return formatAnswer(first, last, answer.rawValue(), format);
+}
+
+void calc::appendResults(
+	const std::vector<Result>& results, std::string& out, std::string_view errorPrefix, AnswerFormat format) {
+	char buffer[MAX_FORMATTED_SIZE + 1]; // and the newline
+	for (const Result& result : results) {
+		if (!result) {
+			out += errorPrefix;
+			out += formattedErrorMessage(result.error);
+			out += '\n';
+			continue;
+		}
+		char* end = formatAnswer(buffer, buffer + MAX_FORMATTED_SIZE, result.answer, format).ptr;
+		*end++ = '\n';
+		out.append(buffer, static_cast<std::size_t>(end - buffer));
+	}
+}
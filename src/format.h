@@ -0,0 +1,43 @@
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include "calculator.h"
+
+#include <charconv>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// Formatting
+// writes answers as text straight into a caller's buffer, without going through iostreams or a locale, in the style of
+// std::to_chars(). Rounded answers are the same text as printing them to a stream set to std::setprecision(MAX_DIGITS)
+namespace calc {
+
+    enum class AnswerFormat : unsigned char {
+        Rounded, // MAX_DIGITS significant digits, like printf's "%.12g"
+        Shortest // fewest digits that still read back as the same double, like std::to_chars() without a precision
+    };
+
+    inline constexpr std::size_t MAX_FORMATTED_SIZE = 32; // a buffer of this size is always large enough
+
+    std::to_chars_result formatAnswer(char* first, char* last, double answer,
+                                      AnswerFormat format = AnswerFormat::Rounded);
+    // same result as std::to_chars(): ptr is the end of the text, or ec is std::errc::value_too_large and the buffer
+    // holds nothing meaningful when [first, last) is too small
+
+    std::to_chars_result formatAnswer(char* first, char* last, const classes::ScientificValue& answer,
+                                      AnswerFormat format = AnswerFormat::Rounded); // formats answer.rawValue()
+
+    [[nodiscard]] const std::string& formattedErrorMessage(ErrorCode error);
+    // same text as errorMessage(error), formatted once for the whole process. error can't be ErrorCode::None
+
+    void appendResults(const std::vector<Result>& results, std::string& out, std::string_view errorPrefix = "",
+                       AnswerFormat format = AnswerFormat::Rounded);
+    // appends one line per result: its answer, or errorPrefix followed by its error message. out only grows, so
+    // clearing and reusing it between batches stops allocating once it is large enough
+
+}
+
+#endif //FORMAT_H
@@ -0,0 +1,165 @@
+#include "formula.h"
+#include "stats.h"
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+
+// Variable Table
+calc::ErrorCode calc::VariableTable::set(std::string_view name, double value) {
+	const stats::FlushOnExit flushOnExit;
+	classes::Number number;
+	const ErrorCode error = toNumber(value, number);
+	if (error != ErrorCode::None) return error;
+
+	Variable& variable = variables[getSlot(name)];
+	variable.value = number;
+	variable.isDefined = true;
+	++variable.version;
+	return ErrorCode::None;
+}
+
+calc::ErrorCode calc::VariableTable::toNumber(double value, classes::Number& number) {
+	if (std::abs(value) <= MAX_EXACT_INTEGER && value == std::trunc(value)) {
+		number = classes::Number(static_cast<long long>(value));
+		return ErrorCode::None;
+	}
+	if (!std::isfinite(value) || !utils::isBounded(value)) return ErrorCode::Overflow;
+	number = classes::Number(utils::makeScientific(value));
+	return ErrorCode::None;
+}
+
+void calc::VariableTable::unset(std::string_view name) {
+	Variable& variable = variables[getSlot(name)];
+	if (!variable.isDefined) return;
+	variable.isDefined = false;
+	++variable.version;
+}
+
+bool calc::VariableTable::isDefined(std::string_view name) const {
+	const auto found = slots.find(std::string(name));
+	return found != slots.end() && variables[found->second].isDefined;
+}
+
+unsigned int calc::VariableTable::getSlot(std::string_view name) {
+	const auto [found, isNew] = slots.emplace(std::string(name), static_cast<unsigned int>(variables.size()));
+	if (isNew) variables.emplace_back();
+	return found->second;
+}
+
+
+// Formula
+calc::Formula::Formula(classes::FlatAST&& t, VariableTable& variables): table(&variables), tree(std::move(t)) {
+	using classes::NodeType;
+
+	tree.simplify();
+	parents.assign(tree.size(), NO_PARENT);
+	cache.resize(tree.size());
+	isDirty.assign(tree.size(), true); // nothing has been evaluated yet
+	for (const std::string& name : tree.variableNames()) slots.push_back(table->getSlot(name));
+	for (Node n = 0; n < tree.size(); ++n) {
+		const classes::FlatNode& node = tree[n];
+		switch (node.type) {
+		case NodeType::Value: break;
+
+		case NodeType::Variable: {
+			const unsigned int slot = slots[node.left];
+			uses.push_back({n, slot, table->variables[slot].version});
+			break;
+		}
+
+		case NodeType::Negation: parents[node.left] = n; break;
+
+		default:
+			parents[node.left] = n;
+			parents[node.right] = n;
+		}
+	}
+}
+
+calc::Result calc::Formula::evaluate() {
+	const stats::FlushOnExit flushOnExit;
+	// a variable that changed makes its nodes dirty, along with every node above them. Stopping at the first node
+	// that is already dirty is enough, since the nodes above it are already dirty too
+	for (VariableUse& use : uses) {
+		const unsigned long long version = table->variables[use.slot].version;
+		if (use.version == version) continue;
+		use.version = version;
+		for (Node n = use.node; n != NO_PARENT && !isDirty[n]; n = parents[n]) isDirty[n] = true;
+	}
+
+	// nodes are in post-order, so the children of a dirty node are always evaluated before it
+	numEvaluatedNodes = 0;
+	for (Node n = 0; n < tree.size(); ++n) {
+		if (!isDirty[n]) continue;
+		evaluate(n);
+		isDirty[n] = false;
+		++numEvaluatedNodes;
+	}
+
+	const CachedNode& root = cache[tree.root()];
+	Result result;
+	result.error = root.error;
+	result.offset = root.errorOffset;
+	if (result) result.answer = utils::roundAnswer(root.value);
+	return result;
+}
+
+void calc::Formula::evaluate(Node n) {
+	using classes::NodeType;
+
+	// errors are the ones FlatAST::tryEvaluate() would raise: its recursion stops at the first error of the left
+	// subtree, then at the first error of the right one, and only then at the operation itself
+	const classes::FlatNode& node = tree[n];
+	CachedNode& cached = cache[n];
+	switch (node.type) {
+	case NodeType::Value:
+		cached = {node.constant, ErrorCode::None, 0};
+		return;
+
+	case NodeType::Variable: {
+		const VariableTable::Variable& variable = table->variables[slots[node.left]];
+		if (variable.isDefined) cached = {variable.value, ErrorCode::None, 0};
+		else cached = {{}, ErrorCode::UndefinedVariable, node.position};
+		return;
+	}
+
+	case NodeType::Negation:
+		cached = cache[node.left];
+		if (cached.error == ErrorCode::None) cached.value = cached.value.negated();
+		return;
+
+	default: break;
+	}
+
+	const CachedNode& left = cache[node.left];
+	const CachedNode& right = cache[node.right];
+	if (left.error != ErrorCode::None) {
+		cached = left;
+		return;
+	}
+	if (right.error != ErrorCode::None) {
+		cached = right;
+		return;
+	}
+
+	classes::Number answer;
+	switch (node.type) {
+	case NodeType::Add:
+	case NodeType::Subtract:
+		cached.error = utils::addOrSubtract(left.value, right.value, node.type == NodeType::Subtract, answer);
+		break;
+
+	case NodeType::Multiply:
+	case NodeType::Divide:
+		cached.error = utils::multiplyOrDivide(left.value, right.value, node.type == NodeType::Divide, answer);
+		break;
+
+	default: throw std::logic_error("Unexpected node type in Formula::evaluate method");
+	}
+	cached.value = answer;
+	cached.errorOffset = cached.error == ErrorCode::None ? 0 : node.position;
+}
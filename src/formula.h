@@ -0,0 +1,98 @@
+#ifndef FORMULA_H
+#define FORMULA_H
+
+#include "calculator.h"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+// Formulas
+// expressions with named variables, compiled once by Calculator::compile() and then evaluated again every time their
+// variables change. Each node keeps its last value, and only the nodes above variables that changed are evaluated
+// again. Constant subtrees are folded when the formula is compiled, or else evaluated once and never again
+namespace calc {
+
+    // values of the variables used by formulas. Every variable gets a slot the first time it is named, and each slot
+    // counts how many times it has been set so that formulas can tell which of their variables changed
+    class VariableTable {
+    public:
+
+        static inline constexpr double MAX_EXACT_INTEGER = 9007199254740992.0; // 2 ^ 53
+
+        ErrorCode set(std::string_view name, double value);
+        // a variable with an integer value up to 2 ^ 53 is exact, like an integer literal. Other values are rounded
+        // to MAX_DIGITS + 1 digits. Returns Overflow, and leaves the variable unchanged, when value is out of bounds
+
+        static ErrorCode toNumber(double value, classes::Number& number); // the value set() gives to a variable
+
+        void unset(std::string_view name); // formulas using the variable raise UndefinedVariable again
+
+        [[nodiscard]] bool isDefined(std::string_view name) const;
+
+        [[nodiscard]] unsigned int getSlot(std::string_view name); // creates an undefined variable the first time
+
+    private:
+
+        friend class Formula;
+
+        struct Variable {
+            classes::Number value;
+            unsigned long long version = 0; // incremented by every set() and unset()
+            bool isDefined = false;
+        };
+
+        std::unordered_map<std::string, unsigned int> slots;
+        std::vector<Variable> variables; // indexed by slot
+    };
+
+    // bound to the table it was compiled with, which needs to outlive it. Not safe to evaluate from several threads
+    class Formula {
+    public:
+
+        Formula(classes::FlatAST&& tree, VariableTable& variables);
+        // tree is simplified first. Built by Calculator::compile(), which parses tree with variables allowed
+
+        Result evaluate();
+        // same result as tryCalculate() on the expression with a literal in place of each variable, when its value is
+        // an integer. Only the nodes that depend on variables set since the last call are evaluated again
+
+        [[nodiscard]] std::size_t size() const { return tree.size(); } // number of nodes after simplifying
+        [[nodiscard]] std::size_t getNumEvaluatedNodes() const { return numEvaluatedNodes; } // by the last evaluate()
+
+    private:
+
+        using Node = classes::FlatAST::Node;
+
+        static inline constexpr Node NO_PARENT = ~Node{0};
+
+        struct CachedNode {
+            classes::Number value; // only meaningful when error is None
+            ErrorCode error = ErrorCode::None; // first error in the subtree, raised again until the subtree changes
+            unsigned int errorOffset = 0;
+        };
+
+        struct VariableUse { // one per Variable node
+            Node node;
+            unsigned int slot;
+            unsigned long long version; // of the variable when the node was last evaluated
+        };
+
+        VariableTable* table;
+        classes::FlatAST tree;
+        std::vector<unsigned int> slots; // in table, of each name in tree.variableNames()
+        std::vector<Node> parents;
+        std::vector<CachedNode> cache; // indexed like the nodes of tree
+        std::vector<unsigned char> isDirty; // dirty nodes always have dirty parents, up to the root
+        std::vector<VariableUse> uses;
+        std::size_t numEvaluatedNodes = 0;
+
+        void evaluate(Node n);
+    };
+
+}
+
+#endif //FORMULA_H
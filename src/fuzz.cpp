@@ -0,0 +1,51 @@
+#include "differential.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Fuzz target: checks that every engine agrees with the reference on the input, see differential.h, and aborts
+// otherwise so that the fuzzer keeps the input. Built with CALC_LIBFUZZER, libFuzzer provides main() and generates
+// the inputs (clang only). Otherwise the main() below runs each file given as argument, or stdin without any, once:
+// what AFL expects from a target built with afl-clang-fast++, and the way to replay a crash of either fuzzer.
+// Latency is left to the fuzzers, e.g. libFuzzer's -timeout=, and measured by the differential harness instead
+// Usage: calculator_fuzz [<input file>...]
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size) {
+    static calc::differential::Checker checker; // kept between inputs, like the scratch space of real callers
+    const std::string_view expression(reinterpret_cast<const char*>(data), size);
+    const std::vector<calc::differential::Mismatch> mismatches = checker.check(expression);
+    if (mismatches.empty()) return 0;
+
+    std::fprintf(stderr, "Mismatch for \"%.*s\"\n", static_cast<int>(size), expression.data());
+    for (const calc::differential::Mismatch& mismatch : mismatches)
+        std::fprintf(stderr, "    %s: %s instead of %s\n", mismatch.engine, mismatch.actual.c_str(),
+                     mismatch.expected.c_str());
+    std::abort();
+}
+
+#if !defined(CALC_LIBFUZZER)
+int main(int argc, char** argv) {
+    const auto run = [](const std::string& input) {
+        LLVMFuzzerTestOneInput(reinterpret_cast<const std::uint8_t*>(input.data()), input.size());
+    };
+
+    if (argc == 1) run(std::string(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>()));
+    for (int i = 1; i < argc; ++i) {
+        std::ifstream file(argv[i], std::ios::binary);
+        if (!file) {
+            std::fprintf(stderr, "Can't read %s\n", argv[i]);
+            return 1;
+        }
+        run(std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()));
+    }
+    return 0;
+}
+#endif
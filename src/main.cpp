@@ -1,8 +1,10 @@
 #include "calculator.h"
+#include "format.h"
 
 #include <exception>
-#include <iomanip>
 #include <iostream>
+#include <string>
+#include <string_view>
 
 void displayFeatures() {
     std::cout << "------------------------------------- Calculator rules and features -------------------------------------" << "\n";
@@ -19,14 +21,17 @@ void displayFeatures() {
     std::cout << "* Parentheses adjacent to numbers or other parentheses are padded by * . Example:" << "\n";
     std::cout << "      \"2(1/2)4(5-7)(0+1)\" is evaluated as \"2*(1/2)*4*(5-7)*(0+1)\"" << "\n";
     std::cout << "* Supports values with great orders of magnitude (up to around 10^" << std::to_string(calc::MAX_MAGNITUDE) << ")" << "\n";
+#if defined(CALC_DECIMAL_BACKEND)
+    std::cout << "* Returns exact answers with high precision (currently set to " << std::to_string(calc::DECIMAL_DIGITS) << " digits of precision)" << "\n";
+#else
     std::cout << "* Returns answers with high precision (currently set to " << std::to_string(calc::MAX_DIGITS) << " digits of precision)" << "\n";
+#endif
     std::cout << "---------------------------------------------------------------------------------------------------------" << "\n";
     std::cout << "\n";
 }
 
 int main() {
     Calculator calc;
-    std::cout << std::setprecision(calc::MAX_DIGITS);
 
     displayFeatures();
 
@@ -39,11 +44,18 @@ int main() {
         if (input == "d") { displayFeatures(); continue; }
         else if (input == "e") break;
 
+#if defined(CALC_DECIMAL_BACKEND)
+        const calc::DecimalResult result = calc.tryCalculateDecimal(input);
+        if (result) std::cout << "Answer: " << result.answer.toString() << "\n\n";
+        else std::cout << "ERROR / INVALID INPUT : " << result.message() << "\n\n";
+#else
         try {
-            calc.calculate(input);
-            std::cout << "Answer: " << calc.getLastAnswer() << "\n\n";
+            char answer[calc::MAX_FORMATTED_SIZE];
+            const char* end = calc::formatAnswer(answer, answer + sizeof(answer), calc.calculate(input)).ptr;
+            std::cout << "Answer: " << std::string_view(answer, end - answer) << "\n\n";
         } catch (const std::exception& e) {
             std::cout << "ERROR / INVALID INPUT : " << e.what() << "\n\n";
         }
+#endif
     }
 }
\ No newline at end of file
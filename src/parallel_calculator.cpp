@@ -0,0 +1,160 @@
+#include "parallel_calculator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+
+namespace {
+	std::uint32_t chunksBegin(std::uint64_t chunks) { return static_cast<std::uint32_t>(chunks >> 32); }
+
+	std::uint32_t chunksEnd(std::uint64_t chunks) { return static_cast<std::uint32_t>(chunks); }
+
+	std::uint64_t packChunks(std::uint32_t begin, std::uint32_t end) {
+		return static_cast<std::uint64_t>(begin) << 32 | end;
+	}
+}
+
+
+ParallelCalculator::ParallelCalculator(unsigned int numThreads)
+	: numWorkers(std::max(numThreads, 1u))
+	, workers(std::make_unique<Worker[]>(numWorkers))
+{
+	threads.reserve(numWorkers - 1);
+	for (unsigned int id = 1; id < numWorkers; ++id)
+		threads.emplace_back(&ParallelCalculator::run, this, id);
+}
+
+ParallelCalculator::~ParallelCalculator() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		isStopping = true;
+	}
+	batchStarted.notify_all();
+	for (std::thread& thread : threads) thread.join();
+}
+
+std::vector<calc::Result> ParallelCalculator::calculateBatch(const std::vector<std::string_view>& batch) {
+	std::vector<calc::Result> batchResults(batch.size());
+	const auto numChunks = static_cast<std::uint32_t>((batch.size() + CHUNK_SIZE - 1) / CHUNK_SIZE);
+
+	std::lock_guard<std::mutex> batchLock(batchMutex);
+	expressions = &batch;
+	results = &batchResults;
+
+	if (numChunks <= 1 || numWorkers == 1) { // not worth waking the other threads up
+		workers[0].chunks.store(packChunks(0, numChunks));
+		work(0);
+		return batchResults;
+	}
+
+	for (unsigned int id = 0; id < numWorkers; ++id) {
+		const auto begin = static_cast<std::uint32_t>(std::uint64_t{numChunks} * id / numWorkers);
+		const auto end = static_cast<std::uint32_t>(std::uint64_t{numChunks} * (id + 1) / numWorkers);
+		workers[id].chunks.store(packChunks(begin, end));
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		++batchNumber;
+		numBusyWorkers = numWorkers - 1;
+	}
+	batchStarted.notify_all();
+
+	work(0);
+
+	// every thread has to be done before the batch goes out of scope, even one that had nothing left to steal
+	std::unique_lock<std::mutex> lock(mutex);
+	batchFinished.wait(lock, [this] { return numBusyWorkers == 0; });
+	return batchResults;
+}
+
+void ParallelCalculator::enableCache(std::size_t capacity) {
+	std::lock_guard<std::mutex> batchLock(batchMutex);
+	if (capacity == 0) cache.reset();
+	else cache = std::make_unique<calc::StripedResultCache>(capacity);
+}
+
+void ParallelCalculator::run(unsigned int id) {
+	unsigned long long lastBatchNumber = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			batchStarted.wait(lock, [&] { return isStopping || batchNumber != lastBatchNumber; });
+			if (isStopping) return;
+			lastBatchNumber = batchNumber;
+		}
+
+		work(id);
+
+		bool isLast;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			isLast = --numBusyWorkers == 0;
+		}
+		if (isLast) batchFinished.notify_one();
+	}
+}
+
+void ParallelCalculator::work(unsigned int id) {
+	std::uint32_t chunk;
+	while (takeChunk(id, chunk) || stealChunk(id, chunk))
+		calculateChunk(id, chunk);
+}
+
+bool ParallelCalculator::takeChunk(unsigned int id, std::uint32_t& chunk) {
+	std::atomic<std::uint64_t>& chunks = workers[id].chunks;
+	std::uint64_t current = chunks.load();
+	while (chunksBegin(current) < chunksEnd(current)) {
+		if (chunks.compare_exchange_weak(current, packChunks(chunksBegin(current) + 1, chunksEnd(current)))) {
+			chunk = chunksBegin(current);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ParallelCalculator::stealChunk(unsigned int id, std::uint32_t& chunk) {
+	while (true) {
+		// the victim is the worker with the most chunks left, and it keeps the first half of them
+		unsigned int victim = id;
+		std::uint64_t victimChunks = 0;
+		std::uint32_t mostChunks = 0;
+		for (unsigned int other = 0; other < numWorkers; ++other) {
+			const std::uint64_t chunks = workers[other].chunks.load();
+			const std::uint32_t numChunks = chunksEnd(chunks) - chunksBegin(chunks);
+			if (other != id && numChunks > mostChunks) {
+				victim = other;
+				victimChunks = chunks;
+				mostChunks = numChunks;
+			}
+		}
+		if (mostChunks == 0) return false;
+
+		const std::uint32_t begin = chunksBegin(victimChunks);
+		const std::uint32_t end = chunksEnd(victimChunks);
+		const std::uint32_t middle = begin + mostChunks / 2;
+		if (workers[victim].chunks.compare_exchange_strong(victimChunks, packChunks(begin, middle))) {
+			workers[id].chunks.store(packChunks(middle + 1, end)); // own chunks are empty, so no one else writes them
+			chunk = middle;
+			return true;
+		}
+		// the victim took or lost a chunk in the meantime, so look again
+	}
+}
+
+void ParallelCalculator::calculateChunk(unsigned int id, std::uint32_t chunk) {
+	const std::size_t begin = std::size_t{chunk} * CHUNK_SIZE;
+	const std::size_t end = std::min(begin + CHUNK_SIZE, expressions->size());
+	calc::classes::FlatAST& tree = workers[id].tree;
+	for (std::size_t i = begin; i < end; ++i) {
+		const std::string_view expression = (*expressions)[i];
+		(*results)[i] = cache ? cache->evaluate(expression, tree) : Calculator::evaluate(expression, tree);
+	}
+}
@@ -0,0 +1,80 @@
+#ifndef PARALLEL_CALCULATOR_H
+#define PARALLEL_CALCULATOR_H
+
+#include "calculator.h"
+#include "result_cache.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+
+// Parallel Calculator
+// spreads batches of expressions over a pool of threads. A batch is cut into chunks of CHUNK_SIZE expressions, and
+// each thread starts with an equal share of chunks. A thread that runs out steals half of the chunks left to the
+// thread that has the most, so a few very long expressions can't leave the other threads waiting on one thread.
+class ParallelCalculator {
+public:
+
+    static inline constexpr unsigned int CHUNK_SIZE = 32;
+
+    explicit ParallelCalculator(unsigned int numThreads = std::thread::hardware_concurrency());
+    // numThreads includes the thread calling calculateBatch(), which works on the batch too. 0 is treated as 1
+
+    ~ParallelCalculator();
+
+    ParallelCalculator(const ParallelCalculator&) = delete;
+    ParallelCalculator& operator=(const ParallelCalculator&) = delete;
+
+    std::vector<calc::Result> calculateBatch(const std::vector<std::string_view>& expressions);
+    // same results as Calculator::calculateBatch(), in the same order. Batches from several threads run one at a time
+
+    [[nodiscard]] unsigned int getNumThreads() const { return numWorkers; }
+
+    void enableCache(std::size_t capacity);
+    // same as Calculator::enableCache(), with a cache shared by all threads. Waits for the current batch to finish
+
+    [[nodiscard]] const calc::StripedResultCache* getCache() const { return cache.get(); } // nullptr when disabled
+
+private:
+
+    struct alignas(64) Worker { // aligned so that workers updating their chunks don't share cache lines
+        std::atomic<std::uint64_t> chunks{0}; // chunks [begin, end) left to this worker, packed as begin << 32 | end
+        calc::classes::FlatAST tree;
+    };
+
+    unsigned int numWorkers;
+    std::unique_ptr<calc::StripedResultCache> cache;
+    std::unique_ptr<Worker[]> workers; // worker 0 is the thread calling calculateBatch()
+    std::vector<std::thread> threads; // threads[i] runs workers[i + 1]
+
+    // current batch
+    const std::vector<std::string_view>* expressions = nullptr;
+    std::vector<calc::Result>* results = nullptr;
+    unsigned long long batchNumber = 0; // incremented to wake the threads up for a new batch
+    unsigned int numBusyWorkers = 0;
+    bool isStopping = false;
+
+    std::mutex batchMutex; // held for the whole of calculateBatch()
+    std::mutex mutex; // guards the batch members above
+    std::condition_variable batchStarted;
+    std::condition_variable batchFinished;
+
+    void run(unsigned int id);
+
+    void work(unsigned int id);
+
+    bool takeChunk(unsigned int id, std::uint32_t& chunk);
+
+    bool stealChunk(unsigned int id, std::uint32_t& chunk);
+
+    void calculateChunk(unsigned int id, std::uint32_t chunk);
+};
+
+#endif //PARALLEL_CALCULATOR_H
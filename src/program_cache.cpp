@@ -0,0 +1,194 @@
+#include "program_cache.h"
+#include "wire.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+// File Format
+namespace {
+	constexpr char MAGIC[8] = {'C', 'A', 'L', 'C', 'P', 'R', 'O', 'G'};
+
+	// header: MAGIC, then version, wire format version, MAX_DIGITS and MAX_MAGNITUDE in 4 bytes each, then the number
+	// of entries in 8 bytes
+	constexpr std::size_t HEADER_SIZE = sizeof(MAGIC) + 4 * 4 + 8;
+
+	// index entry: hash of the expression and offset of the entry in the file in 8 bytes each, then sizes of the
+	// expression and of its program in 4 bytes each
+	constexpr std::size_t ENTRY_SIZE = 8 + 8 + 4 + 4;
+
+	struct Entry {
+		std::uint64_t hash;
+		std::string_view expression;
+		std::size_t programOffset; // in the encoded programs, until they are written
+		std::size_t programSize;
+	};
+
+	void putNumber(std::string& out, std::uint64_t value, std::size_t size) {
+		for (std::size_t i = 0; i < size; ++i) out += static_cast<char>(value >> (8 * i));
+	}
+
+	std::uint64_t getNumber(const unsigned char* in, std::size_t size) {
+		std::uint64_t value = 0;
+		for (std::size_t i = 0; i < size; ++i) value |= static_cast<std::uint64_t>(in[i]) << (8 * i);
+		return value;
+	}
+
+	std::string header(std::uint64_t numEntries) {
+		std::string out(MAGIC, sizeof(MAGIC));
+		putNumber(out, calc::PROGRAM_CACHE_VERSION, 4);
+		putNumber(out, calc::wire::VERSION, 4);
+		putNumber(out, calc::MAX_DIGITS, 4);
+		putNumber(out, calc::MAX_MAGNITUDE, 4);
+		putNumber(out, numEntries, 8);
+		return out;
+	}
+}
+
+std::uint64_t calc::hashExpression(std::string_view expression) {
+	std::uint64_t hash = 14695981039346656037ULL;
+	for (const char c : expression) {
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+
+// Writing
+bool calc::writeProgramCache(const char* path, const std::vector<std::string_view>& expressions) {
+	std::vector<Entry> entries;
+	entries.reserve(expressions.size());
+	for (const std::string_view expression : expressions)
+		entries.push_back({hashExpression(expression), expression, 0, 0});
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+		return a.hash != b.hash ? a.hash < b.hash : a.expression < b.expression;
+	});
+	entries.erase(std::unique(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+		return a.hash == b.hash && a.expression == b.expression;
+	}), entries.end());
+
+	// programs are encoded first, so that invalid expressions can be left out of the index
+	std::vector<unsigned char> programs;
+	std::size_t numValid = 0;
+	for (Entry& entry : entries) {
+		if (entry.expression.size() > UINT32_MAX) continue; // sizes are stored in 4 bytes
+		classes::Program program;
+		try { program = Calculator::compile(entry.expression); }
+		catch (const std::exception&) { continue; }
+		entry.programOffset = programs.size();
+		entry.programSize = wire::encodedSize(program);
+		programs.resize(programs.size() + entry.programSize);
+		if (wire::encode(program, programs.data() + entry.programOffset, entry.programSize) == 0) {
+			programs.resize(entry.programOffset); // can't be decoded, so it would never be found
+			continue;
+		}
+		entries[numValid++] = entry;
+	}
+	entries.resize(numValid);
+
+	std::string out = header(entries.size());
+	std::size_t offset = HEADER_SIZE + entries.size() * ENTRY_SIZE;
+	for (const Entry& entry : entries) {
+		putNumber(out, entry.hash, 8);
+		putNumber(out, offset, 8);
+		putNumber(out, entry.expression.size(), 4);
+		putNumber(out, entry.programSize, 4);
+		offset += entry.expression.size() + entry.programSize;
+	}
+	for (const Entry& entry : entries) {
+		out += entry.expression;
+		out.append(reinterpret_cast<const char*>(programs.data() + entry.programOffset), entry.programSize);
+	}
+
+	// written to a temporary file next to path, then renamed over it: processes that still map the old file keep
+	// reading it, and a crash or a full disk leaves the old file in place instead of a truncated one
+	std::string temporary = std::string(path) + ".XXXXXX";
+	const int fd = ::mkstemp(temporary.data());
+	if (fd < 0) return false;
+	std::FILE* file = ::fdopen(fd, "wb");
+	if (file == nullptr) {
+		const int error = errno;
+		::close(fd);
+		::unlink(temporary.c_str());
+		errno = error;
+		return false;
+	}
+	bool isWritten = ::fchmod(fd, 0644) == 0; // instead of mkstemp()'s 0600, like a file written by fopen()
+	isWritten = isWritten && std::fwrite(out.data(), 1, out.size(), file) == out.size();
+	isWritten = isWritten && std::fflush(file) == 0 && ::fsync(fd) == 0;
+	isWritten = std::fclose(file) == 0 && isWritten;
+	if (isWritten && std::rename(temporary.c_str(), path) == 0) return true;
+	const int error = errno;
+	::unlink(temporary.c_str());
+	errno = error;
+	return false;
+}
+
+
+// Reading
+calc::ProgramCache::ProgramCache(const char* path) {
+	fd = ::open(path, O_RDONLY);
+	if (fd < 0) return;
+	struct stat info{};
+	if (::fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < HEADER_SIZE) return;
+	fileSize = static_cast<std::size_t>(info.st_size);
+	void* mapping = ::mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (mapping == MAP_FAILED) return;
+	data = static_cast<const unsigned char*>(mapping);
+
+	const std::string expected = header(0);
+	constexpr std::size_t NUM_ENTRIES_OFFSET = HEADER_SIZE - 8;
+	if (std::memcmp(data, expected.data(), NUM_ENTRIES_OFFSET) != 0) return; // other format, version or precision
+	const std::uint64_t n = getNumber(data + NUM_ENTRIES_OFFSET, 8);
+	if (n > (fileSize - HEADER_SIZE) / ENTRY_SIZE) return;
+	numEntries = static_cast<std::size_t>(n);
+	index = data + HEADER_SIZE;
+}
+
+calc::ProgramCache::~ProgramCache() {
+	if (data != nullptr) ::munmap(const_cast<unsigned char*>(data), fileSize);
+	if (fd >= 0) ::close(fd);
+}
+
+bool calc::ProgramCache::find(std::string_view expression, classes::Program& program) const {
+	if (index == nullptr) return false;
+
+	// binary search for the first entry with the hash, then through the entries that share it
+	const std::uint64_t hash = hashExpression(expression);
+	std::size_t low = 0;
+	std::size_t high = numEntries;
+	while (low < high) {
+		const std::size_t middle = low + (high - low) / 2;
+		if (getNumber(index + middle * ENTRY_SIZE, 8) < hash) low = middle + 1;
+		else high = middle;
+	}
+
+	for (std::size_t e = low; e < numEntries; ++e) {
+		const unsigned char* entry = index + e * ENTRY_SIZE;
+		if (getNumber(entry, 8) != hash) return false;
+		const std::uint64_t offset = getNumber(entry + 8, 8);
+		const std::uint64_t expressionSize = getNumber(entry + 16, 4);
+		const std::uint64_t programSize = getNumber(entry + 20, 4);
+		if (offset > fileSize || expressionSize + programSize > fileSize - offset) return false; // corrupt
+		if (std::string_view(reinterpret_cast<const char*>(data + offset), expressionSize) != expression) continue;
+
+		std::size_t consumed;
+		const wire::WireError error = wire::decode(data + offset + expressionSize, programSize, program, consumed);
+		return error == wire::WireError::None && consumed == programSize;
+	}
+	return false;
+}
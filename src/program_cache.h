@@ -0,0 +1,60 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include "calculator.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+
+// Program Cache
+// compiled programs of a library of expressions, stored in a file that a fresh process maps into memory to start
+// executing them without parsing anything. The file holds a header, an index of the entries sorted by the hash of their
+// expression, then each entry's expression followed by its program in the wire format (see wire.h). Every number is
+// little-endian, so a file can be shared by every platform.
+// Files are only read when they were written by a build with the same version, wire format and precision, since
+// programs hold constants already rounded to MAX_DIGITS + 1 digits. Each lookup checks the expression's hash and text
+// against its entry, and decoding validates the program, so a stale or corrupt entry is never executed
+namespace calc {
+
+    inline constexpr std::uint32_t PROGRAM_CACHE_VERSION = 1; // increased for each change to the file format
+
+    std::uint64_t hashExpression(std::string_view expression); // FNV-1a, which gives the same hash in every process
+
+    bool writeProgramCache(const char* path, const std::vector<std::string_view>& expressions);
+    // compiles every expression and writes the cache file, replacing any file at path all at once, so that readers see
+    // either the old file or the new one. Invalid expressions, and any repetition of an expression, are left out.
+    // Returns false with errno set when the file can't be written, leaving any old file as it was
+
+    // not copyable, since it owns the mapping. Safe to share between threads, which all read the same mapping
+    class ProgramCache {
+    public:
+
+        explicit ProgramCache(const char* path);
+        // maps the file. valid() is false when it can't be read or isn't a cache file this build can read
+
+        ~ProgramCache();
+        ProgramCache(const ProgramCache&) = delete;
+        ProgramCache& operator=(const ProgramCache&) = delete;
+
+        [[nodiscard]] bool valid() const { return index != nullptr; }
+        [[nodiscard]] std::size_t size() const { return numEntries; }
+
+        bool find(std::string_view expression, classes::Program& program) const;
+        // decodes the program of expression into program, reusing its capacity. Returns false when expression isn't
+        // in the cache or its entry is corrupt, in which case the caller compiles it instead
+
+    private:
+
+        int fd = -1;
+        const unsigned char* data = nullptr; // the whole file
+        std::size_t fileSize = 0;
+        const unsigned char* index = nullptr; // nullptr unless the header is valid
+        std::size_t numEntries = 0;
+    };
+
+}
+
+#endif //PROGRAM_CACHE_H
@@ -0,0 +1,147 @@
+#include "result_cache.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+
+// Normalization
+std::string_view calc::normalizeExpression(std::string_view expression, std::string& buffer) {
+	std::size_t pos = expression.find(' ');
+	if (pos == std::string_view::npos) return expression;
+
+	buffer.assign(expression.data(), pos);
+	while (pos < expression.size()) {
+		pos = utils::skipSpaces(expression, pos);
+		const std::size_t end = std::min(expression.find(' ', pos), expression.size());
+		buffer.append(expression.data() + pos, end - pos);
+		pos = end;
+	}
+	return buffer;
+}
+
+unsigned int calc::toExpressionOffset(std::string_view expression, unsigned int normalizedOffset) {
+	unsigned int numChars = 0; // characters of the normalized expression seen so far
+	for (unsigned int i = 0; i < expression.size(); ++i) {
+		if (expression[i] == ' ') continue;
+		if (numChars++ == normalizedOffset) return i;
+	}
+	return static_cast<unsigned int>(expression.size()); // errors found at the end of the expression
+}
+
+
+// Result Cache
+calc::ResultCache::ResultCache(std::size_t capacity): maxSize(capacity) {
+	index.reserve(capacity);
+}
+
+calc::Result calc::ResultCache::evaluate(std::string_view expression, classes::FlatAST& tree) {
+	const std::string_view normalized = normalizeExpression(expression, buffer);
+	Result result;
+	if (!find(normalized, result)) {
+		result = Calculator::evaluate(normalized, tree);
+		insert(normalized, result);
+	}
+	if (!result && normalized.size() != expression.size()) result.offset = toExpressionOffset(expression, result.offset);
+	return result;
+}
+
+bool calc::ResultCache::find(std::string_view normalized, Result& result) {
+	const auto found = index.find(normalized);
+	if (found == index.end()) {
+		++numMisses;
+		return false;
+	}
+
+	++numHits;
+	entries.splice(entries.begin(), entries, found->second); // list iterators, and so keys, stay valid
+	result = found->second->result;
+	return true;
+}
+
+void calc::ResultCache::insert(std::string_view normalized, const Result& result) {
+	if (maxSize == 0 || index.count(normalized) != 0) return;
+	if (entries.size() == maxSize) { // the least recently used entry makes room for the new one
+		index.erase(entries.back().expression);
+		entries.pop_back();
+	}
+	entries.push_front({std::string(normalized), result});
+	index.emplace(entries.front().expression, entries.begin());
+}
+
+void calc::ResultCache::clear() {
+	index.clear();
+	entries.clear();
+	numHits = 0;
+	numMisses = 0;
+}
+
+
+// Striped Result Cache
+calc::StripedResultCache::StripedResultCache(std::size_t capacity) {
+	const std::size_t stripeCapacity = (capacity + NUM_STRIPES - 1) / NUM_STRIPES;
+	stripes.reserve(NUM_STRIPES);
+	for (unsigned int i = 0; i < NUM_STRIPES; ++i) stripes.push_back(std::make_unique<Stripe>(stripeCapacity));
+}
+
+calc::Result calc::StripedResultCache::evaluate(std::string_view expression, classes::FlatAST& tree) {
+	thread_local std::string buffer; // every thread normalizes into its own buffer
+	const std::string_view normalized = normalizeExpression(expression, buffer);
+	Stripe& stripe = *stripes[std::hash<std::string_view>{}(normalized) % NUM_STRIPES];
+
+	Result result;
+	bool isFound;
+	{
+		std::lock_guard<std::mutex> lock(stripe.mutex);
+		isFound = stripe.cache.find(normalized, result);
+	}
+	if (!isFound) {
+		result = Calculator::evaluate(normalized, tree);
+		std::lock_guard<std::mutex> lock(stripe.mutex);
+		stripe.cache.insert(normalized, result);
+	}
+	if (!result && normalized.size() != expression.size()) result.offset = toExpressionOffset(expression, result.offset);
+	return result;
+}
+
+void calc::StripedResultCache::clear() {
+	for (const std::unique_ptr<Stripe>& stripe : stripes) {
+		std::lock_guard<std::mutex> lock(stripe->mutex);
+		stripe->cache.clear();
+	}
+}
+
+std::size_t calc::StripedResultCache::size() const {
+	std::size_t total = 0;
+	for (const std::unique_ptr<Stripe>& stripe : stripes) {
+		std::lock_guard<std::mutex> lock(stripe->mutex);
+		total += stripe->cache.size();
+	}
+	return total;
+}
+
+std::size_t calc::StripedResultCache::capacity() const {
+	return stripes[0]->cache.capacity() * NUM_STRIPES;
+}
+
+unsigned long long calc::StripedResultCache::getNumHits() const {
+	unsigned long long total = 0;
+	for (const std::unique_ptr<Stripe>& stripe : stripes) {
+		std::lock_guard<std::mutex> lock(stripe->mutex);
+		total += stripe->cache.getNumHits();
+	}
+	return total;
+}
+
+unsigned long long calc::StripedResultCache::getNumMisses() const {
+	unsigned long long total = 0;
+	for (const std::unique_ptr<Stripe>& stripe : stripes) {
+		std::lock_guard<std::mutex> lock(stripe->mutex);
+		total += stripe->cache.getNumMisses();
+	}
+	return total;
+}
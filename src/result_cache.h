@@ -0,0 +1,103 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include "calculator.h"
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+// Result Cache
+// results of expressions, keyed by their normalized form: the expression without its spaces. The Lexer skips spaces
+// everywhere (digits separated by spaces still make one literal), so expressions that only differ by spaces have the
+// same answer or error. Error offsets are stored in the normalized expression and mapped back to each expression
+namespace calc {
+
+    std::string_view normalizeExpression(std::string_view expression, std::string& buffer);
+    // returns expression itself when it has no space, or else its copy without spaces, written into buffer
+
+    unsigned int toExpressionOffset(std::string_view expression, unsigned int normalizedOffset);
+    // index in expression of the character at normalizedOffset in its normalized form
+
+    // least recently used results are dropped once the cache holds capacity of them. Not safe to share between threads
+    class ResultCache {
+    public:
+
+        explicit ResultCache(std::size_t capacity);
+
+        ResultCache(const ResultCache&) = delete;
+        ResultCache& operator=(const ResultCache&) = delete;
+
+        Result evaluate(std::string_view expression, classes::FlatAST& tree);
+        // same result as Calculator::evaluate(), which is only called when the result isn't already in the cache
+
+        bool find(std::string_view normalized, Result& result);
+        // counts a hit or a miss. On a hit, result is set and becomes the most recently used one
+
+        void insert(std::string_view normalized, const Result& result);
+        // does nothing if normalized is already in the cache, like when another thread got to insert it first
+
+        void clear(); // also resets the counters
+
+        [[nodiscard]] std::size_t size() const { return entries.size(); }
+        [[nodiscard]] std::size_t capacity() const { return maxSize; }
+        [[nodiscard]] unsigned long long getNumHits() const { return numHits; }
+        [[nodiscard]] unsigned long long getNumMisses() const { return numMisses; }
+
+    private:
+
+        struct Entry {
+            std::string expression; // normalized
+            Result result;
+        };
+
+        std::size_t maxSize;
+        std::list<Entry> entries; // most recently used first
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> index; // keys point into entries
+        unsigned long long numHits = 0;
+        unsigned long long numMisses = 0;
+        std::string buffer; // normalized expression, reused by every call to evaluate()
+    };
+
+    // same cache, safe to share between threads. Expressions are spread over NUM_STRIPES caches by the hash of their
+    // normalized form, each with its own lock, so threads only wait on each other when their expressions share a
+    // stripe. Expressions are evaluated without holding any lock
+    class StripedResultCache {
+    public:
+
+        static inline constexpr unsigned int NUM_STRIPES = 16;
+
+        explicit StripedResultCache(std::size_t capacity);
+        // capacity is split evenly between the stripes, rounded up so that each one holds at least one result
+
+        Result evaluate(std::string_view expression, classes::FlatAST& tree);
+        // same as ResultCache::evaluate(). Threads calling it at the same time need their own trees
+
+        void clear();
+
+        [[nodiscard]] std::size_t size() const;
+        [[nodiscard]] std::size_t capacity() const;
+        [[nodiscard]] unsigned long long getNumHits() const;
+        [[nodiscard]] unsigned long long getNumMisses() const;
+
+    private:
+
+        struct alignas(64) Stripe { // aligned so that locking one stripe doesn't slow down threads using the next one
+            mutable std::mutex mutex;
+            ResultCache cache;
+
+            explicit Stripe(std::size_t capacity): cache(capacity) {}
+        };
+
+        std::vector<std::unique_ptr<Stripe>> stripes; // pointers since mutexes can't be moved
+    };
+
+}
+
+#endif //RESULT_CACHE_H
@@ -0,0 +1,487 @@
+#include "calculator.h"
+#include "format.h"
+#include "parallel_calculator.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <coroutine>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <csignal>
+#include <climits>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Serves expressions over TCP and Unix sockets, one answer or error per expression, in the order they were received.
+// Requests are either lines or length-prefixed frames: a 4-byte big-endian length followed by that many bytes, and
+// answers are framed the same way. One thread runs an epoll loop where every connection is a coroutine. Each turn of
+// the loop reads every connection that has data, gathers all their complete requests into one batch for a
+// ParallelCalculator, then writes each connection's answers with one writev(). Clients can send as many requests as
+// they like without waiting for answers.
+// Prints "Listening on <address>" for each socket once it listens, with the port the system picked for port 0.
+// Usage: calculator_server [--tcp [<host>:]<port>] [--unix <path>] [--threads <n>] [--cache <capacity>]
+//                          [--length-prefixed]
+
+namespace {
+    constexpr std::size_t MAX_REQUEST_SIZE = 1 << 20; // longer requests close their connection
+    constexpr std::size_t READ_SIZE = 1 << 16;
+    constexpr int MAX_EVENTS = 256;
+
+    // false unless all of text is a number in the range of value, so that "4x", "-1" or "" aren't taken for one
+    template <typename Number>
+    bool parseNumber(const char* text, Number& value) {
+        const char* end = text + std::strlen(text);
+        const auto [last, error] = std::from_chars(text, end, value);
+        return error == std::errc() && last == end;
+    }
+
+    class Loop;
+
+    struct Watcher { // coroutines waiting on one socket, resumed by the loop when epoll reports it ready
+        std::coroutine_handle<> reader;
+        std::coroutine_handle<> writer;
+    };
+
+    // coroutine started right away, and destroyed by its loop once it finishes
+    struct Task {
+        struct promise_type {
+            Loop* loop;
+            Watcher watcher; // in the promise and not the coroutine's locals, so that it outlives the coroutine's body
+
+            template <typename... Args>
+            explicit promise_type(Loop& l, Args&&...): loop(&l) {}
+
+            Task get_return_object() { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            auto final_suspend() noexcept;
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+
+    struct ThisWatcher { // Watcher& watcher = co_await ThisWatcher{}; gives the running coroutine's watcher
+        Watcher* watcher = nullptr;
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<Task::promise_type> handle) noexcept {
+            watcher = &handle.promise().watcher;
+            return false; // carries on right away
+        }
+        Watcher& await_resume() const noexcept { return *watcher; }
+    };
+
+    class Loop {
+    public:
+
+        Loop(unsigned int numThreads, std::size_t cacheCapacity)
+            : calculator(numThreads), epoll(::epoll_create1(EPOLL_CLOEXEC)) {
+            if (cacheCapacity != 0) calculator.enableCache(cacheCapacity);
+        }
+
+        ~Loop() { ::close(epoll); }
+
+        [[nodiscard]] bool valid() const { return epoll >= 0; }
+
+        bool watch(int fd, Watcher& watcher) { // edge-triggered, so sockets have to be read and written until EAGAIN
+            epoll_event event{};
+            event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            event.data.ptr = &watcher;
+            return ::epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) == 0;
+        }
+
+        struct Readiness { // co_await Loop::readable(watcher) and co_await Loop::writable(watcher)
+            std::coroutine_handle<>& waiting;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) noexcept { waiting = handle; }
+            void await_resume() const noexcept {}
+        };
+
+        static Readiness readable(Watcher& watcher) { return {watcher.reader}; }
+        static Readiness writable(Watcher& watcher) { return {watcher.writer}; }
+
+        struct Evaluation { // co_await loop.evaluate(requests, results), resumed once the next batch is evaluated
+            Loop& loop;
+            const std::vector<std::string_view>& requests;
+            std::vector<calc::Result>& results;
+            bool await_ready() const noexcept { return requests.empty(); }
+            void await_suspend(std::coroutine_handle<> handle) {
+                loop.waiters.push_back({handle, &results, loop.batch.size()});
+                loop.batch.insert(loop.batch.end(), requests.begin(), requests.end());
+            }
+            void await_resume() const noexcept {}
+        };
+
+        Evaluation evaluate(const std::vector<std::string_view>& requests, std::vector<calc::Result>& results) {
+            return {*this, requests, results};
+        }
+
+        void finish(std::coroutine_handle<> handle) { finished.push_back(handle); }
+
+        void run() {
+            epoll_event events[MAX_EVENTS];
+            while (true) {
+                const int numEvents = ::epoll_wait(epoll, events, MAX_EVENTS, batch.empty() ? -1 : 0);
+                if (numEvents < 0 && errno != EINTR) {
+                    std::perror("epoll_wait");
+                    return;
+                }
+                for (int i = 0; i < numEvents; ++i) {
+                    // finished coroutines are only destroyed below, so their watchers stay valid until the end of the
+                    // turn, even when they closed their socket after epoll_wait() reported it
+                    auto& watcher = *static_cast<Watcher*>(events[i].data.ptr);
+                    const std::uint32_t ready = events[i].events;
+                    if ((ready & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0 && watcher.reader)
+                        std::exchange(watcher.reader, nullptr).resume();
+                    if ((ready & (EPOLLOUT | EPOLLHUP | EPOLLERR)) != 0 && watcher.writer)
+                        std::exchange(watcher.writer, nullptr).resume();
+                }
+                evaluateBatch();
+                for (std::coroutine_handle<> handle : finished) handle.destroy();
+                finished.clear();
+            }
+        }
+
+    private:
+
+        struct Waiter {
+            std::coroutine_handle<> handle;
+            std::vector<calc::Result>* results;
+            std::size_t begin; // of its requests in the batch
+        };
+
+        ParallelCalculator calculator;
+        int epoll;
+        std::vector<std::string_view> batch; // requests of every waiter, which point into their connection's buffer
+        std::vector<Waiter> waiters;
+        std::vector<calc::Result> batchResults;
+        std::vector<std::coroutine_handle<>> finished;
+
+        void evaluateBatch() {
+            if (batch.empty()) return;
+            batchResults = calculator.calculateBatch(batch);
+            batch.clear();
+
+            // resumed waiters can start the next batch, so work on a copy of this one's
+            std::vector<Waiter> resumed;
+            resumed.swap(waiters);
+            for (const Waiter& waiter : resumed) {
+                const auto first = batchResults.begin() + static_cast<std::ptrdiff_t>(waiter.begin);
+                waiter.results->assign(first, first + static_cast<std::ptrdiff_t>(waiter.results->size()));
+            }
+            for (const Waiter& waiter : resumed) waiter.handle.resume();
+        }
+    };
+
+    auto Task::promise_type::final_suspend() noexcept {
+        struct Finish {
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<promise_type> handle) const noexcept {
+                handle.promise().loop->finish(handle);
+            }
+            void await_resume() const noexcept {}
+        };
+        return Finish{};
+    }
+
+    // Responses
+    // answers are formatted into one slot each. Error messages are the same for every response, so they are written
+    // straight from formattedErrorMessage() and the constants below, along with the length prefixes around them
+    struct Slot {
+        char bytes[40]; // length prefix and answer, or answer and newline, or only the length prefix of an error
+        unsigned int length;
+    };
+
+    constexpr std::string_view ERROR_PREFIX = "ERROR / INVALID INPUT : ";
+    const char NEWLINE = '\n';
+
+    unsigned int putLength(char* out, std::size_t length) {
+        const auto value = static_cast<std::uint32_t>(length);
+        out[0] = static_cast<char>(value >> 24);
+        out[1] = static_cast<char>(value >> 16);
+        out[2] = static_cast<char>(value >> 8);
+        out[3] = static_cast<char>(value);
+        return 4;
+    }
+
+    // fills iovecs with the responses to results. slots needs a stable address until the iovecs are written
+    void gatherResponses(const std::vector<calc::Result>& results, bool isLengthPrefixed, std::vector<Slot>& slots,
+                         std::vector<iovec>& iovecs) {
+        slots.resize(results.size());
+        iovecs.clear();
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            const calc::Result& result = results[i];
+            Slot& slot = slots[i];
+            if (!result) {
+                const std::string& message = calc::formattedErrorMessage(result.error);
+                if (isLengthPrefixed) {
+                    slot.length = putLength(slot.bytes, ERROR_PREFIX.size() + message.size());
+                    iovecs.push_back({slot.bytes, slot.length});
+                }
+                iovecs.push_back({const_cast<char*>(ERROR_PREFIX.data()), ERROR_PREFIX.size()});
+                iovecs.push_back({const_cast<char*>(message.data()), message.size()});
+                if (!isLengthPrefixed) iovecs.push_back({const_cast<char*>(&NEWLINE), 1});
+                continue;
+            }
+
+            const unsigned int prefix = isLengthPrefixed ? 4 : 0;
+            const char* end = calc::formatAnswer(slot.bytes + prefix, slot.bytes + sizeof(slot.bytes) - 1,
+                                                 result.answer).ptr;
+            const auto length = static_cast<unsigned int>(end - (slot.bytes + prefix));
+            if (isLengthPrefixed) putLength(slot.bytes, length);
+            else slot.bytes[length] = '\n';
+            slot.length = prefix + length + (isLengthPrefixed ? 0 : 1);
+            iovecs.push_back({slot.bytes, slot.length});
+        }
+    }
+
+    // Connections
+    struct Options {
+        bool isLengthPrefixed = false;
+    };
+
+    // splits the complete requests off the front of input, and returns how many bytes they took. Sets isTooLong when
+    // the first request can't be complete before growing over MAX_REQUEST_SIZE
+    std::size_t splitRequests(std::string_view input, bool isLengthPrefixed, std::vector<std::string_view>& requests,
+                              bool& isTooLong) {
+        requests.clear();
+        std::size_t begin = 0;
+        while (true) {
+            if (isLengthPrefixed) {
+                if (input.size() - begin < 4) break;
+                const auto* header = reinterpret_cast<const unsigned char*>(input.data() + begin);
+                const std::size_t length = std::size_t{header[0]} << 24 | std::size_t{header[1]} << 16 |
+                                           std::size_t{header[2]} << 8 | std::size_t{header[3]};
+                if (length > MAX_REQUEST_SIZE) {
+                    isTooLong = true;
+                    break;
+                }
+                if (input.size() - begin - 4 < length) break;
+                requests.push_back(input.substr(begin + 4, length));
+                begin += 4 + length;
+            }
+            else {
+                const std::size_t end = input.find('\n', begin);
+                if (end == std::string_view::npos) {
+                    isTooLong = input.size() - begin > MAX_REQUEST_SIZE;
+                    break;
+                }
+                std::string_view line = input.substr(begin, end - begin);
+                if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+                requests.push_back(line);
+                begin = end + 1;
+            }
+        }
+        return begin;
+    }
+
+    // writes every iovec, waiting for the socket to be writable whenever it's full. Returns false on errors
+    struct WriteAll {
+        int fd;
+        Watcher& watcher;
+        std::vector<iovec>& iovecs;
+        std::size_t first = 0;
+
+        bool advance() { // writes as much as possible, returns true when done or failed
+            while (first < iovecs.size()) {
+                const auto count = static_cast<int>(std::min<std::size_t>(iovecs.size() - first, IOV_MAX));
+                const ssize_t written = ::writev(fd, &iovecs[first], count);
+                if (written < 0) {
+                    if (errno == EINTR) continue;
+                    return errno != EAGAIN && errno != EWOULDBLOCK;
+                }
+                auto remaining = static_cast<std::size_t>(written);
+                while (remaining != 0 && remaining >= iovecs[first].iov_len) remaining -= iovecs[first++].iov_len;
+                if (remaining != 0) {
+                    iovecs[first].iov_base = static_cast<char*>(iovecs[first].iov_base) + remaining;
+                    iovecs[first].iov_len -= remaining;
+                }
+            }
+            return true;
+        }
+    };
+
+    Task serveConnection(Loop& loop, int fd, Options options) {
+        Watcher& watcher = co_await ThisWatcher{};
+        if (!loop.watch(fd, watcher)) {
+            ::close(fd);
+            co_return;
+        }
+
+        std::string input;
+        std::vector<std::string_view> requests;
+        std::vector<calc::Result> results;
+        std::vector<Slot> slots;
+        std::vector<iovec> iovecs;
+        bool isOpen = true;
+        while (isOpen) {
+            bool isDrained = false;
+            while (!isDrained && input.size() < MAX_REQUEST_SIZE + 4) {
+                const std::size_t size = input.size();
+                input.resize(size + READ_SIZE);
+                const ssize_t numRead = ::read(fd, input.data() + size, READ_SIZE);
+                input.resize(size + static_cast<std::size_t>(std::max<ssize_t>(numRead, 0)));
+                if (numRead > 0) continue;
+                if (numRead < 0 && errno == EINTR) continue;
+                isDrained = true;
+                if (numRead == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) isOpen = false;
+            }
+
+            bool isTooLong = false;
+            const std::size_t consumed = splitRequests(input, options.isLengthPrefixed, requests, isTooLong);
+            if (!requests.empty()) {
+                results.resize(requests.size());
+                co_await loop.evaluate(requests, results);
+
+                gatherResponses(results, options.isLengthPrefixed, slots, iovecs);
+                WriteAll write{fd, watcher, iovecs};
+                while (!write.advance()) co_await Loop::writable(watcher);
+                if (write.first < iovecs.size()) break; // failed
+            }
+            input.erase(0, consumed);
+            if (isTooLong) break;
+            // data that arrived while requests were evaluated didn't wake anyone up, so read again before waiting
+            if (isOpen && isDrained && requests.empty()) co_await Loop::readable(watcher);
+        }
+        ::close(fd);
+    }
+
+    Task acceptConnections(Loop& loop, int listener, Options options) {
+        Watcher& watcher = co_await ThisWatcher{};
+        if (!loop.watch(listener, watcher)) co_return;
+        while (true) {
+            const int fd = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd >= 0) {
+                const int one = 1;
+                ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // fails harmlessly on Unix sockets
+                serveConnection(loop, fd, options);
+            }
+            else if (errno == EAGAIN || errno == EWOULDBLOCK) co_await Loop::readable(watcher);
+            else if (errno != EINTR && errno != ECONNABORTED) {
+                std::perror("accept4");
+                co_await Loop::readable(watcher); // out of file descriptors for example, try again later
+            }
+        }
+    }
+
+    // Listeners
+    int listenTcp(const std::string& address) {
+        const std::size_t colon = address.rfind(':');
+        const std::string host = colon == std::string::npos ? "127.0.0.1" : address.substr(0, colon);
+        const std::string port = colon == std::string::npos ? address : address.substr(colon + 1);
+
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        addrinfo* found = nullptr;
+        if (const int error = ::getaddrinfo(host.c_str(), port.c_str(), &hints, &found); error != 0) {
+            std::fprintf(stderr, "%s: %s\n", address.c_str(), ::gai_strerror(error));
+            return -1;
+        }
+        int fd = -1;
+        for (const addrinfo* info = found; info != nullptr && fd < 0; info = info->ai_next) {
+            fd = ::socket(info->ai_family, info->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, info->ai_protocol);
+            if (fd < 0) continue;
+            const int one = 1;
+            ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (::bind(fd, info->ai_addr, info->ai_addrlen) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+        if (fd < 0) std::perror(address.c_str());
+        ::freeaddrinfo(found);
+        if (fd < 0) return -1;
+
+        // with port 0 the system picks one, so the bound address is printed for clients to find
+        sockaddr_storage bound{};
+        socklen_t boundSize = sizeof(bound);
+        char boundHost[NI_MAXHOST] = "?";
+        char boundPort[NI_MAXSERV] = "?";
+        if (::getsockname(fd, reinterpret_cast<sockaddr*>(&bound), &boundSize) == 0)
+            ::getnameinfo(reinterpret_cast<const sockaddr*>(&bound), boundSize, boundHost, sizeof(boundHost),
+                          boundPort, sizeof(boundPort), NI_NUMERICHOST | NI_NUMERICSERV);
+        std::printf("Listening on %s:%s\n", boundHost, boundPort);
+        std::fflush(stdout);
+        return fd;
+    }
+
+    int listenUnix(const std::string& path) {
+        sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path)) {
+            std::fprintf(stderr, "%s: path too long\n", path.c_str());
+            return -1;
+        }
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        ::unlink(path.c_str()); // left behind by a previous run
+
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0 || ::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(fd, SOMAXCONN) != 0) {
+            std::perror(path.c_str());
+            if (fd >= 0) ::close(fd);
+            return -1;
+        }
+        std::printf("Listening on %s\n", path.c_str());
+        std::fflush(stdout);
+        return fd;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> tcpAddresses;
+    std::vector<std::string> unixPaths;
+    unsigned int numThreads = std::thread::hardware_concurrency();
+    std::size_t cacheCapacity = 0;
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view argument = argv[i];
+        if (argument == "--tcp" && i + 1 < argc) tcpAddresses.emplace_back(argv[++i]);
+        else if (argument == "--unix" && i + 1 < argc) unixPaths.emplace_back(argv[++i]);
+        else if (argument == "--threads" && i + 1 < argc && parseNumber(argv[i + 1], numThreads)) ++i;
+        else if (argument == "--cache" && i + 1 < argc && parseNumber(argv[i + 1], cacheCapacity)) ++i;
+        else if (argument == "--length-prefixed") options.isLengthPrefixed = true;
+        else { // including bad numbers
+            tcpAddresses.clear();
+            unixPaths.clear();
+            break;
+        }
+    }
+    if (tcpAddresses.empty() && unixPaths.empty()) {
+        std::fprintf(stderr, "Usage: %s [--tcp [<host>:]<port>] [--unix <path>] [--threads <n>] [--cache <capacity>] "
+                             "[--length-prefixed]\n", argv[0]);
+        return 2;
+    }
+
+    std::signal(SIGPIPE, SIG_IGN); // writing to a closed connection fails with EPIPE instead
+
+    Loop loop(numThreads, cacheCapacity);
+    if (!loop.valid()) {
+        std::perror("epoll_create1");
+        return 1;
+    }
+    std::vector<int> listeners;
+    for (const std::string& address : tcpAddresses) listeners.push_back(listenTcp(address));
+    for (const std::string& path : unixPaths) listeners.push_back(listenUnix(path));
+    if (std::find(listeners.begin(), listeners.end(), -1) != listeners.end()) return 1;
+
+    for (const int listener : listeners) acceptConnections(loop, listener, options);
+    loop.run();
+    return 1;
+}
@@ -0,0 +1,235 @@
+#include "calculator.h"
+#include "format.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <csignal>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Smoke test of calculator_server, run by CTest: starts the server on a port the system picks, once reading lines and
+// once length-prefixed frames, and checks its answers to a pipelined batch, large enough to fill the socket buffers
+// both ways and written while the answers are read, and to connections half-closed right after their requests, whose
+// answers must all arrive before the server closes them. Expected answers are the calculator's own, formatted the way
+// the server formats them. Exits with 1 when an answer is missing, wrong or late.
+// Usage: calculator_server_smoke <calculator_server>
+
+namespace {
+    constexpr std::string_view ERROR_PREFIX = "ERROR / INVALID INPUT : ";
+    constexpr std::size_t NUM_PIPELINED = 200000;
+    constexpr int NUM_HALF_CLOSED = 20;
+    constexpr int RECEIVE_BUFFER_SIZE = 1 << 16; // small, so that the server's writes fill it and stop part way
+    constexpr int TIMEOUT_SECONDS = 10; // for each read and write, so that a stuck server fails instead of hanging
+
+    class Server { // started on construction on 127.0.0.1 and a free port, stopped on destruction
+    public:
+        Server(const char* path, bool isLengthPrefixed) {
+            int output[2];
+            if (::pipe2(output, O_CLOEXEC) != 0) return;
+            pid = ::fork();
+            if (pid == 0) {
+                ::dup2(output[1], STDOUT_FILENO);
+                const char* arguments[] = {path, "--tcp", "127.0.0.1:0", "--threads", "2",
+                                           isLengthPrefixed ? "--length-prefixed" : nullptr, nullptr};
+                ::execv(path, const_cast<char* const*>(arguments));
+                ::_exit(127);
+            }
+            ::close(output[1]);
+
+            // its first line is "Listening on 127.0.0.1:<port>", printed once it accepts connections
+            std::string line;
+            char c;
+            while (pid > 0 && ::read(output[0], &c, 1) == 1 && c != '\n') line += c;
+            ::close(output[0]);
+            const std::size_t colon = line.rfind(':');
+            if (line.rfind("Listening on ", 0) == 0 && colon != std::string::npos)
+                port = std::atoi(line.c_str() + colon + 1);
+        }
+
+        ~Server() {
+            if (pid <= 0) return;
+            ::kill(pid, SIGTERM);
+            ::waitpid(pid, nullptr, 0);
+        }
+
+        Server(const Server&) = delete;
+        Server& operator=(const Server&) = delete;
+
+        [[nodiscard]] int getPort() const { return port; } // 0 when the server didn't start
+
+    private:
+        pid_t pid = -1;
+        int port = 0;
+    };
+
+    int connectTo(int port) {
+        const int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &RECEIVE_BUFFER_SIZE, sizeof(RECEIVE_BUFFER_SIZE));
+        const timeval timeout{TIMEOUT_SECONDS, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<std::uint16_t>(port));
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    bool writeAll(int fd, std::string_view data) {
+        while (!data.empty()) {
+            const ssize_t written = ::write(fd, data.data(), data.size());
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) return false;
+            data.remove_prefix(static_cast<std::size_t>(written));
+        }
+        return true;
+    }
+
+    // reads until size bytes arrived, or until the server closes the connection when size is 0
+    std::string readSome(int fd, std::size_t size) {
+        std::string data;
+        char buffer[1 << 16];
+        while (size == 0 || data.size() < size) {
+            const ssize_t numRead = ::read(fd, buffer, sizeof(buffer));
+            if (numRead < 0 && errno == EINTR) continue;
+            if (numRead <= 0) break; // closed, or timed out
+            data.append(buffer, static_cast<std::size_t>(numRead));
+        }
+        return data;
+    }
+
+    std::string frame(std::string_view text) {
+        const auto length = static_cast<std::uint32_t>(text.size());
+        std::string out{static_cast<char>(length >> 24), static_cast<char>(length >> 16),
+                        static_cast<char>(length >> 8), static_cast<char>(length)};
+        return out.append(text);
+    }
+
+    // requests for expressions, one line or frame each
+    std::string encodeRequests(const std::vector<std::string>& expressions, bool isLengthPrefixed) {
+        std::string out;
+        for (const std::string& expression : expressions)
+            out += isLengthPrefixed ? frame(expression) : expression + '\n';
+        return out;
+    }
+
+    // what the server must answer to expressions, in order
+    std::string expectedResponses(Calculator& calculator, const std::vector<std::string>& expressions,
+                                  bool isLengthPrefixed) {
+        const std::vector<std::string_view> views(expressions.begin(), expressions.end());
+        std::string lines;
+        calc::appendResults(calculator.calculateBatch(views), lines, ERROR_PREFIX);
+        if (!isLengthPrefixed) return lines;
+        std::string out;
+        for (std::size_t begin = 0, end; (end = lines.find('\n', begin)) != std::string::npos; begin = end + 1)
+            out += frame(std::string_view(lines).substr(begin, end - begin));
+        return out;
+    }
+
+    // answers, errors, spaces and empty requests, in a mix that's different at every index
+    std::vector<std::string> makeExpressions(std::size_t count) {
+        std::vector<std::string> expressions;
+        for (std::size_t i = 0; i < count; ++i) {
+            const std::string n = std::to_string(i);
+            switch (i % 7) {
+            case 0: expressions.push_back(n + "+1"); break;
+            case 1: expressions.push_back("2*(3+" + n + ")"); break;
+            case 2: expressions.push_back(n + "/0"); break;
+            case 3: expressions.push_back("(" + n); break;
+            case 4: expressions.push_back(" " + n + " / 7 "); break;
+            case 5: expressions.push_back(n + "#"); break;
+            default: expressions.push_back(i % 2 == 0 ? "" : "-" + n + "." + n);
+            }
+        }
+        return expressions;
+    }
+
+    bool report(const char* check, bool isLengthPrefixed, const std::string& expected, const std::string& actual) {
+        const char* mode = isLengthPrefixed ? "length-prefixed" : "lines";
+        if (actual == expected) {
+            std::printf("%s, %s: ok\n", check, mode);
+            return true;
+        }
+        std::size_t offset = 0;
+        while (offset < expected.size() && offset < actual.size() && expected[offset] == actual[offset]) ++offset;
+        std::printf("%s, %s: got %zu bytes instead of %zu, differing from byte %zu\n", check, mode, actual.size(),
+                    expected.size(), offset);
+        return false;
+    }
+
+    // all the requests at once, from another thread, while this one reads the answers. Reading starts late, once the
+    // answers filled the socket buffers, so that the server has to resume writes that stopped in the middle of one
+    bool checkPipelined(int port, Calculator& calculator, bool isLengthPrefixed) {
+        const std::vector<std::string> expressions = makeExpressions(NUM_PIPELINED);
+        const std::string requests = encodeRequests(expressions, isLengthPrefixed);
+        const std::string expected = expectedResponses(calculator, expressions, isLengthPrefixed);
+        const int fd = connectTo(port);
+        if (fd < 0) return report("Pipelined batch", isLengthPrefixed, expected, "");
+        bool isWritten = false;
+        std::thread writer([&] { isWritten = writeAll(fd, requests); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        const std::string actual = readSome(fd, expected.size());
+        writer.join();
+        ::close(fd);
+        return report("Pipelined batch", isLengthPrefixed, expected, isWritten ? actual : "");
+    }
+
+    // the requests then shutdown(SHUT_WR): the answers must all come before the server closes its side. Every other
+    // connection is corked, so that the end of the requests arrives with them and the server reads both at once
+    bool checkHalfClosed(int port, Calculator& calculator, bool isLengthPrefixed) {
+        const std::vector<std::string> expressions = {"1+2", "2*3", "1/0", "(4", "10/4"};
+        const std::string expected = expectedResponses(calculator, expressions, isLengthPrefixed);
+        const std::string requests = encodeRequests(expressions, isLengthPrefixed);
+        std::string actual;
+        for (int i = 0; i < NUM_HALF_CLOSED; ++i) {
+            const int fd = connectTo(port);
+            if (fd < 0) return report("Half-closed connection", isLengthPrefixed, expected, "");
+            const int isCorked = i % 2;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_CORK, &isCorked, sizeof(isCorked));
+            const bool isWritten = writeAll(fd, requests) && ::shutdown(fd, SHUT_WR) == 0;
+            actual = isWritten ? readSome(fd, 0) : "";
+            ::close(fd);
+            if (actual != expected) break;
+        }
+        return report("Half-closed connection", isLengthPrefixed, expected, actual);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        std::fprintf(stderr, "Usage: %s <calculator_server>\n", argv[0]);
+        return 2;
+    }
+
+    Calculator calculator;
+    bool isPassing = true;
+    for (const bool isLengthPrefixed : {false, true}) {
+        const Server server(argv[1], isLengthPrefixed);
+        if (server.getPort() == 0) {
+            std::printf("%s didn't start\n", argv[1]);
+            return 1;
+        }
+        isPassing &= checkPipelined(server.getPort(), calculator, isLengthPrefixed);
+        isPassing &= checkHalfClosed(server.getPort(), calculator, isLengthPrefixed);
+    }
+    return isPassing ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+#include "stats.h"
+
+#include <atomic>
+
+
+// Statistics
+namespace {
+	using calc::stats::Counter;
+	using calc::stats::Histogram;
+	using calc::stats::Phase;
+
+	constexpr auto NUM_COUNTERS = static_cast<std::size_t>(Counter::NUM_COUNTERS);
+	constexpr auto NUM_PHASES = static_cast<std::size_t>(Phase::NUM_PHASES);
+
+#if defined(CALC_STATS)
+	struct alignas(64) SharedCounter { // one cache line each, so that threads counting different things don't collide
+		std::atomic<unsigned long long> value{0};
+	};
+
+	struct alignas(64) SharedHistogram {
+		std::atomic<unsigned long long> buckets[Histogram::NUM_BUCKETS] = {};
+		std::atomic<unsigned long long> count{0};
+		std::atomic<unsigned long long> totalNanoseconds{0};
+	};
+
+	SharedCounter counters[NUM_COUNTERS];
+	SharedHistogram phases[NUM_PHASES];
+
+	std::size_t bucketOf(unsigned long long nanoseconds) {
+		std::size_t bucket = 0;
+		while (nanoseconds > 1 && bucket + 1 < Histogram::NUM_BUCKETS) {
+			nanoseconds >>= 1;
+			++bucket;
+		}
+		return bucket;
+	}
+#endif
+}
+
+unsigned long long calc::stats::Histogram::percentile(double fraction) const {
+	if (count == 0) return 0;
+	const auto rank = static_cast<unsigned long long>(fraction * static_cast<double>(count));
+	unsigned long long numBelow = 0;
+	for (std::size_t bucket = 0; bucket < NUM_BUCKETS; ++bucket) {
+		numBelow += buckets[bucket];
+		if (numBelow > rank) return 2ULL << bucket;
+	}
+	return 2ULL << (NUM_BUCKETS - 1);
+}
+
+calc::stats::Snapshot calc::stats::snapshot() {
+	Snapshot snapshot;
+#if defined(CALC_STATS)
+	flush();
+	snapshot.isEnabled = true;
+	for (std::size_t c = 0; c < NUM_COUNTERS; ++c) snapshot.counters[c] = counters[c].value.load(std::memory_order_relaxed);
+	for (std::size_t p = 0; p < NUM_PHASES; ++p) {
+		Histogram& histogram = snapshot.phases[p];
+		for (std::size_t bucket = 0; bucket < Histogram::NUM_BUCKETS; ++bucket)
+			histogram.buckets[bucket] = phases[p].buckets[bucket].load(std::memory_order_relaxed);
+		histogram.count = phases[p].count.load(std::memory_order_relaxed);
+		histogram.totalNanoseconds = phases[p].totalNanoseconds.load(std::memory_order_relaxed);
+	}
+#endif
+	return snapshot;
+}
+
+void calc::stats::reset() {
+#if defined(CALC_STATS)
+	for (unsigned long long& count : localCounters) count = 0;
+	for (SharedCounter& counter : counters) counter.value.store(0, std::memory_order_relaxed);
+	for (SharedHistogram& histogram : phases) {
+		for (std::atomic<unsigned long long>& bucket : histogram.buckets) bucket.store(0, std::memory_order_relaxed);
+		histogram.count.store(0, std::memory_order_relaxed);
+		histogram.totalNanoseconds.store(0, std::memory_order_relaxed);
+	}
+#endif
+}
+
+const char* calc::stats::name(Counter counter) {
+	switch (counter) {
+	case Counter::LexerTokens: return "lexerTokens";
+	case Counter::NodesCreated: return "nodesCreated";
+	case Counter::MakeScientificCalls: return "makeScientificCalls";
+	case Counter::InvalidArgumentErrors: return "invalidArgumentErrors";
+	case Counter::OverflowErrors: return "overflowErrors";
+	case Counter::DomainErrors: return "domainErrors";
+	case Counter::Allocations: return "allocations";
+	case Counter::BytesAllocated: return "bytesAllocated";
+	case Counter::NUM_COUNTERS: break;
+	}
+	return "unknown";
+}
+
+const char* calc::stats::name(Phase phase) {
+	switch (phase) {
+	case Phase::Parse: return "parse";
+	case Phase::Evaluate: return "evaluate";
+	case Phase::Calculate: return "calculate";
+	case Phase::NUM_PHASES: break;
+	}
+	return "unknown";
+}
+
+#if defined(CALC_STATS)
+void calc::stats::add(Counter counter, unsigned long long n) noexcept {
+	counters[static_cast<std::size_t>(counter)].value.fetch_add(n, std::memory_order_relaxed);
+}
+
+void calc::stats::flush() noexcept {
+	for (std::size_t c = 0; c < NUM_COUNTERS; ++c) {
+		if (localCounters[c] == 0) continue;
+		counters[c].value.fetch_add(localCounters[c], std::memory_order_relaxed);
+		localCounters[c] = 0;
+	}
+}
+
+void calc::stats::record(Phase phase, unsigned long long nanoseconds) noexcept {
+	SharedHistogram& histogram = phases[static_cast<std::size_t>(phase)];
+	histogram.buckets[bucketOf(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+	histogram.count.fetch_add(1, std::memory_order_relaxed);
+	histogram.totalNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+#endif
@@ -0,0 +1,137 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <chrono>
+#include <cstddef>
+
+
+// Statistics
+// counters and timing histograms of what the calculator did, only collected when built with the CALC_STATS option.
+// Without it, everything below the snapshot API compiles to nothing and snapshots are all zeros. Counters are shared by
+// every thread, so they add up the work of every Calculator and ParallelCalculator of the process
+namespace calc::stats {
+
+    enum class Counter : unsigned char {
+        LexerTokens, // characters the Lexer read as tokens, a run of digits or a variable name counting once
+        NodesCreated, // by the parser, in FlatASTs
+        MakeScientificCalls,
+        InvalidArgumentErrors, // exceptions thrown, by category
+        OverflowErrors,
+        DomainErrors,
+        Allocations, // by the whole process through operator new, in the executables built with allocation_counter.cpp
+        BytesAllocated,
+        NUM_COUNTERS
+    };
+
+    enum class Phase : unsigned char {
+        Parse, // the Lexer runs inside the parser, so these durations include lexing
+        Evaluate,
+        Calculate, // all of Calculator::evaluate(), which every calculate(), tryCalculate() and batch goes through
+        NUM_PHASES
+    };
+
+    struct Histogram { // of the durations of one phase
+        static inline constexpr std::size_t NUM_BUCKETS = 32;
+
+        unsigned long long buckets[NUM_BUCKETS] = {};
+        // buckets[i] counts durations of [2 ^ i, 2 ^ (i + 1)) ns, buckets[0] also counts 0 ns and the last bucket counts
+        // every longer duration
+        unsigned long long count = 0;
+        unsigned long long totalNanoseconds = 0;
+
+        [[nodiscard]] double mean() const { return count == 0 ? 0 : static_cast<double>(totalNanoseconds) / count; }
+
+        [[nodiscard]] unsigned long long percentile(double fraction) const;
+        // upper bound of the bucket holding that fraction of the durations, in ns. 0 when nothing was recorded
+    };
+
+    struct Snapshot {
+        bool isEnabled = false; // built with CALC_STATS
+        unsigned long long counters[static_cast<std::size_t>(Counter::NUM_COUNTERS)] = {};
+        Histogram phases[static_cast<std::size_t>(Phase::NUM_PHASES)];
+
+        unsigned long long operator[](Counter counter) const { return counters[static_cast<std::size_t>(counter)]; }
+        const Histogram& operator[](Phase phase) const { return phases[static_cast<std::size_t>(phase)]; }
+    };
+
+    [[nodiscard]] Snapshot snapshot();
+    // every value is read atomically, but not all of them at once, so a snapshot taken during evaluations can be off
+    // by the few evaluations in progress. Local counts of the calling thread are flushed first, see addLocal()
+
+    void reset();
+
+    [[nodiscard]] const char* name(Counter counter);
+    [[nodiscard]] const char* name(Phase phase);
+
+#if defined(CALC_STATS)
+    void add(Counter counter, unsigned long long n = 1) noexcept;
+
+    inline thread_local unsigned long long localCounters[static_cast<std::size_t>(Counter::NUM_COUNTERS)] = {};
+
+    inline void addLocal(Counter counter, unsigned long long n = 1) noexcept {
+        localCounters[static_cast<std::size_t>(counter)] += n;
+    }
+    // for the hottest code, where add() would have every thread contend on the counter's cache line: counts stay with
+    // the calling thread until flush(), which every public entry point that evaluates or compiles calls before it
+    // returns or throws. Code calling calc::utils directly takes a snapshot() on the same thread, or flushes itself
+
+    void flush() noexcept; // adds the local counts of the calling thread to the shared counters
+
+    class FlushOnExit { // calls flush() at the end of its scope, however the scope ends
+    public:
+
+        FlushOnExit() = default;
+        FlushOnExit(const FlushOnExit&) = delete;
+        FlushOnExit& operator=(const FlushOnExit&) = delete;
+
+        ~FlushOnExit() { flush(); }
+    };
+
+    void record(Phase phase, unsigned long long nanoseconds) noexcept;
+
+    class PhaseTimer { // times consecutive phases, started on construction
+    public:
+
+        PhaseTimer(): start(std::chrono::steady_clock::now()), last(start) {}
+
+        void lap(Phase phase) noexcept { // records the time since the previous lap, or since construction
+            const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            record(phase, toNanoseconds(now - last));
+            last = now;
+        }
+
+        void total(Phase phase) noexcept { record(phase, toNanoseconds(last - start)); } // up to the last lap
+
+    private:
+
+        std::chrono::steady_clock::time_point start;
+        std::chrono::steady_clock::time_point last;
+
+        static unsigned long long toNanoseconds(std::chrono::steady_clock::duration duration) {
+            return static_cast<unsigned long long>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+        }
+    };
+#else
+    inline void add(Counter, unsigned long long = 1) noexcept {}
+
+    inline void addLocal(Counter, unsigned long long = 1) noexcept {}
+
+    inline void flush() noexcept {}
+
+    class FlushOnExit {};
+
+    inline void record(Phase, unsigned long long) noexcept {}
+
+    class PhaseTimer {
+    public:
+
+        void lap(Phase) noexcept {}
+
+        void total(Phase) noexcept {}
+    };
+#endif
+
+}
+
+#endif //STATS_H
@@ -1,11 +1,87 @@
 #include "calculator.h"
+#include "columnar.h"
+#include "compile_time.h"
+#include "engine.h"
+#include "format.h"
+#include "formula.h"
+#include "parallel_calculator.h"
+#include "program_cache.h"
+#include "result_cache.h"
+#include "stats.h"
+#include "wire.h"
 
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <exception>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
 #include <vector>
 
+// describes the answer or error given by an engine for one input, so that engines can be compared with calculate()
+template <typename Engine>
+std::string describe(Engine&& engine) {
+    std::ostringstream out;
+    out << std::setprecision(17);
+    try { out << engine(); }
+    catch (const std::exception& e) { out << e.what(); }
+    return out.str();
+}
+
+// same description for results that hold errors instead of throwing them
+std::string describe(const calc::Result& result) {
+    if (!result) return result.message();
+    return describe([&] { return result.answer; });
+}
+
+// the original std::pow / std::log10 versions of the scientific helpers, to check the table-based ones against
+namespace legacy {
+    int getScientificMagnitude(double value) {
+        if (value == 0.0) return 0;
+        return std::floor(std::log10(std::abs(value)));
+    }
+
+    calc::classes::ScientificValue makeScientific(double value, unsigned int lastDigit) {
+        if (value == 0.0) return {0.0, 0};
+        int magnitude = getScientificMagnitude(value);
+        int rounded = static_cast<int>(lastDigit) - 1 - magnitude;
+        double exponent = std::pow(10, rounded);
+        value = std::round(value * exponent) / exponent;
+        value = value / std::pow(10, magnitude);
+        return {value, magnitude};
+    }
+
+    double rawValue(const calc::classes::ScientificValue& val) { return val.value * std::pow(10.0, val.magnitude); }
+}
+
+bool isSameDouble(double a, double b) { return std::memcmp(&a, &b, sizeof(a)) == 0 || (a != a && b != b); }
+
+// counts the values for which the table-based helpers differ from the original ones in any bit
+unsigned int countPowerTableMismatches(const std::vector<double>& values) {
+    unsigned int numMismatches = 0;
+    for (double value : values) {
+        bool isSame = calc::utils::getScientificMagnitude(value) == legacy::getScientificMagnitude(value);
+        for (unsigned int lastDigit : {calc::MAX_DIGITS, calc::MAX_DIGITS + 1}) {
+            const calc::classes::ScientificValue fast = calc::utils::makeScientific(value, lastDigit);
+            const calc::classes::ScientificValue original = legacy::makeScientific(value, lastDigit);
+            isSame = isSame && fast.magnitude == original.magnitude && isSameDouble(fast.value, original.value)
+                && isSameDouble(fast.rawValue(), legacy::rawValue(original));
+        }
+        if (!isSame) ++numMismatches;
+    }
+    return numMismatches;
+}
+
 int main() {
     std::vector<std::string> inputs;
     // -------------------- VALID INPUTS START HERE --------------------------
@@ -74,4 +150,505 @@ int main() {
             std::cout << calc.calculate(input) << "\n";
         } catch (const std::exception& e) { std::cout << e.what() << "\n"; }
     }
+
+    // compiled programs must give the same answers and errors as calculate(). Every count of mismatches below is added
+    // to numFailures, which makes the exit status
+    unsigned int numFailures = 0;
+    unsigned int numMismatches = 0;
+    for (const std::string& input : inputs) {
+        const std::string expected = describe([&] { return calc.calculate(input); });
+        const std::string actual = describe([&] { return calc.execute(Calculator::compile(input)); });
+        if (expected != actual) {
+            ++numMismatches;
+            std::cout << "Compiled program mismatch for \"" << input << "\": " << actual << "\n";
+        }
+    }
+    std::cout << "Compiled program mismatches: " << numMismatches << "\n";
+    numFailures += numMismatches;
+
+    // programs and results must decode to the same answers and errors, and decoding again into the same program must
+    // reuse its capacity. Every shorter prefix of a message is truncated. The last inputs compile to constants with
+    // mantissas of 10, just over 10 and just under 1
+    numMismatches = 0;
+    std::vector<std::string> wireInputs = inputs;
+    wireInputs.insert(wireInputs.end(), {"999999999999995*100000", "999999999999995*10000000000",
+                                         "999999999999995*100000000000000000000000000000"});
+    std::vector<unsigned char> message(1024);
+    calc::classes::Program decodedProgram;
+    for (const std::string& input : wireInputs) {
+        const calc::Result result = calc.tryCalculate(input);
+        std::size_t size = calc::wire::encode(result, message.data(), message.size());
+        calc::Result decodedResult;
+        std::size_t consumed = 0;
+        bool isSame = calc::wire::decode(message.data(), size, decodedResult, consumed) == calc::wire::WireError::None
+            && consumed == size && decodedResult.error == result.error && decodedResult.offset == result.offset
+            && isSameDouble(decodedResult.answer, result.answer);
+
+        calc::classes::Program program;
+        try { program = Calculator::compile(input); }
+        catch (const std::exception&) { isSame = isSame && !result; }
+        size = calc::wire::encode(program, message.data(), message.size());
+        isSame = isSame && size == calc::wire::encodedSize(program);
+        for (std::size_t prefix = 0; isSame && prefix < size; ++prefix)
+            isSame = calc::wire::decode(message.data(), prefix, decodedProgram, consumed)
+                == calc::wire::WireError::Truncated;
+        if (isSame && !program.instructions().empty()) {
+            isSame = calc::wire::decode(message.data(), size, decodedProgram, consumed) == calc::wire::WireError::None
+                && consumed == size;
+            const calc::classes::Instruction* instructions = decodedProgram.instructions().data();
+            isSame = isSame && calc::wire::decode(message.data(), size, decodedProgram, consumed)
+                == calc::wire::WireError::None && decodedProgram.instructions().data() == instructions;
+            isSame = isSame && describe([&] { return calc.execute(program); })
+                == describe([&] { return calc.execute(decodedProgram); });
+        }
+        if (!isSame) {
+            ++numMismatches;
+            std::cout << "Wire format mismatch for \"" << input << "\"\n";
+        }
+    }
+    const unsigned char unbalanced[] = {1, calc::wire::VERSION, 2, 0, 2, 3, 0}; // 1 + (missing operand)
+    const unsigned char newer[] = {1, calc::wire::VERSION + 1, 1, 0, 2};
+    std::size_t consumed = 0;
+    std::cout << "Wire format mismatches: " << numMismatches << ", "
+              << calc::wire::errorMessage(calc::wire::decode(unbalanced, sizeof(unbalanced), decodedProgram, consumed))
+              << ", "
+              << calc::wire::errorMessage(calc::wire::decode(newer, sizeof(newer), decodedProgram, consumed)) << "\n";
+    numFailures += numMismatches;
+
+    // programs read back from a cache file must give the same answers and errors as calculate(), even after the file
+    // is rewritten while mapped, including the constants of wireInputs. Invalid inputs and other expressions aren't
+    // found, and neither is anything in a file with another version
+    numMismatches = 0;
+    const char* cachePath = "calculator_test_programs.cache";
+    const std::vector<std::string_view> cachedInputs(wireInputs.begin(), wireInputs.end());
+    if (!calc::writeProgramCache(cachePath, cachedInputs)) std::cout << "Can't write " << cachePath << "\n";
+    std::size_t numRewritten = 0;
+    {
+        const calc::ProgramCache cache(cachePath);
+        if (!calc::writeProgramCache(cachePath, {"1+2"})) std::cout << "Can't rewrite " << cachePath << "\n";
+        numRewritten = calc::ProgramCache(cachePath).size();
+        for (const std::string& input : wireInputs) {
+            bool isCompiled = true;
+            try { Calculator::compile(input); }
+            catch (const std::exception&) { isCompiled = false; }
+            const bool isFound = cache.find(input, decodedProgram);
+            if (isFound != isCompiled || (isFound && describe([&] { return calc.execute(decodedProgram); })
+                                                      != describe([&] { return calc.calculate(input); }))) {
+                ++numMismatches;
+                std::cout << "Program cache mismatch for \"" << input << "\"\n";
+            }
+        }
+        if (cache.find("1+2 ", decodedProgram)) ++numMismatches;
+        std::cout << "Program cache of " << cache.size() << " programs, mismatches: " << numMismatches
+                  << ", rewritten while mapped to " << numRewritten;
+        numFailures += numMismatches;
+    }
+    if (std::FILE* file = std::fopen(cachePath, "r+b")) {
+        std::fseek(file, 8, SEEK_SET);
+        std::fputc(calc::PROGRAM_CACHE_VERSION + 1, file);
+        std::fclose(file);
+    }
+    std::cout << ", other version is " << (calc::ProgramCache(cachePath).valid() ? "valid" : "invalid") << "\n";
+    std::remove(cachePath);
+
+    // batches must give the same answers and errors as calculate()
+    numMismatches = 0;
+    const std::vector<std::string_view> inputViews(inputs.begin(), inputs.end());
+    const std::vector<calc::Result> results = calc.calculateBatch(inputViews);
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+        if (describe([&] { return calc.calculate(inputs[i]); }) != describe(results[i])) {
+            ++numMismatches;
+            std::cout << "Batch mismatch for \"" << inputs[i] << "\"\n";
+        }
+    }
+    std::cout << "Batch mismatches: " << numMismatches << "\n";
+    numFailures += numMismatches;
+
+    // parallel batches must give the same results in the same order, including batches large enough to be stolen from
+    numMismatches = 0;
+    std::vector<std::string_view> largeBatch;
+    for (unsigned int copy = 0; copy < 200; ++copy)
+        largeBatch.insert(largeBatch.end(), inputViews.begin(), inputViews.end());
+    ParallelCalculator parallelCalc(4);
+    const std::vector<std::string_view>* batches[] = {&inputViews, &largeBatch};
+    for (const std::vector<std::string_view>* batch : batches) {
+        const std::vector<calc::Result> parallelResults = parallelCalc.calculateBatch(*batch);
+        for (std::size_t i = 0; i < batch->size(); ++i) {
+            if (describe(results[i % inputs.size()]) != describe(parallelResults[i])) {
+                ++numMismatches;
+                std::cout << "Parallel batch mismatch for \"" << (*batch)[i] << "\"\n";
+            }
+        }
+    }
+    std::cout << "Parallel batch mismatches: " << numMismatches << "\n";
+    numFailures += numMismatches;
+
+    // one engine, with its cache, shared by threads that each have their own session must give the same results as
+    // calculate(), and each session must remember its own last valid expression
+    calc::Engine engine(64);
+    std::string lastValidInput;
+    double lastValidAnswer = 0;
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+        if (!results[i]) continue;
+        lastValidInput = inputs[i];
+        lastValidAnswer = results[i].answer;
+    }
+    std::atomic<unsigned int> numEngineMismatches{0};
+    std::vector<std::thread> sessionThreads;
+    for (unsigned int t = 0; t < 4; ++t) {
+        sessionThreads.emplace_back([&] {
+            calc::Session session(engine);
+            for (unsigned int copy = 0; copy < 50; ++copy) {
+                for (std::size_t i = 0; i < inputs.size(); ++i) {
+                    const calc::Result result = session.tryCalculate(inputs[i]);
+                    if (describe(result) != describe(results[i]) || result.offset != results[i].offset)
+                        ++numEngineMismatches;
+                }
+            }
+            if (session.getLastExpression() != lastValidInput || session.getLastAnswer() != lastValidAnswer)
+                ++numEngineMismatches;
+        });
+    }
+    for (std::thread& thread : sessionThreads) thread.join();
+    std::cout << "Engine mismatches: " << numEngineMismatches << "\n";
+    numFailures += numEngineMismatches;
+
+    // the power tables must give bit-identical results to std::pow and std::log10, on the values reached by the inputs
+    // above and on random values. Random values are spread over every magnitude, with extra ones right around powers
+    // of ten, where std::log10 rounds
+    std::vector<double> values;
+    for (const calc::Result& result : results) values.push_back(result.answer);
+    std::mt19937_64 random(42);
+    std::uniform_real_distribution<double> mantissas(1.0, 10.0);
+    std::uniform_int_distribution<int> magnitudes(-330, 310);
+    for (unsigned int i = 0; i < 1000000; ++i) {
+        const double value = mantissas(random) * std::pow(10.0, magnitudes(random));
+        values.push_back(i % 2 == 0 ? value : -value);
+        const double power = std::pow(10.0, magnitudes(random));
+        values.push_back(std::nextafter(power, 0.0) - power * 1e-16 * static_cast<double>(i % 8));
+        std::uint64_t bits = random();
+        double anyDouble;
+        std::memcpy(&anyDouble, &bits, sizeof(anyDouble));
+        values.push_back(anyDouble);
+    }
+    const unsigned int numPowerTableMismatches = countPowerTableMismatches(values);
+    std::cout << "Power table mismatches: " << numPowerTableMismatches << "\n";
+    numFailures += numPowerTableMismatches;
+
+    // expressions evaluated at compile time must give the same answers, errors and offsets as tryCalculate(), and
+    // their powers of ten and magnitudes must be the same as the power tables give, on the values above
+    static_assert(calc::eval("4*21/(8+3)") == 7.63636363636);
+    static_assert(calc::tryEval("20/(10-10)").error == calc::ErrorCode::DivisionByZero);
+    numMismatches = 0;
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+        const calc::Result result = calc::tryEval(inputs[i]);
+        if (result.error != results[i].error || result.offset != results[i].offset
+            || !isSameDouble(result.answer, results[i].answer)) {
+            ++numMismatches;
+            std::cout << "Compile-time mismatch for \"" << inputs[i] << "\"\n";
+        }
+    }
+    calc::compile_time::Arithmetic arithmetic;
+    using calc::utils::PowerTables;
+    for (int exponent = PowerTables::MIN_POWER; exponent <= PowerTables::MAX_POWER; ++exponent)
+        if (!isSameDouble(arithmetic.powerOfTen(exponent), calc::utils::powerOfTen(exponent))) ++numMismatches;
+    for (double value : values) {
+        if (!std::isfinite(value)) continue;
+        if (arithmetic.getScientificMagnitude(value) != calc::utils::getScientificMagnitude(value)) ++numMismatches;
+    }
+    std::cout << "Compile-time mismatches: " << numMismatches << "\n";
+    numFailures += numMismatches;
+
+    // rounded answers must be formatted as streams set to std::setprecision(MAX_DIGITS) print them, which is printf's
+    // "%.12g", and shortest ones must read back as the same double. Batches are formatted one line per result
+    numMismatches = 0;
+    for (double value : values) {
+        char expected[64];
+        const int length = std::snprintf(expected, sizeof(expected), "%.*g", calc::MAX_DIGITS, value);
+        char actual[calc::MAX_FORMATTED_SIZE];
+        const char* end = calc::formatAnswer(actual, actual + sizeof(actual), value).ptr;
+        bool isSame = std::string_view(expected, length) == std::string_view(actual, end - actual);
+        end = calc::formatAnswer(actual, actual + sizeof(actual), value, calc::AnswerFormat::Shortest).ptr;
+        isSame = isSame && isSameDouble(std::strtod(std::string(actual, end - actual).c_str(), nullptr), value);
+        if (!isSame) ++numMismatches;
+    }
+    std::ostringstream expectedLines;
+    expectedLines << std::setprecision(calc::MAX_DIGITS);
+    for (const calc::Result& result : results) {
+        if (result) expectedLines << result.answer << "\n";
+        else expectedLines << "Error: " << result.message() << "\n";
+    }
+    std::string lines;
+    calc::appendResults(results, lines, "Error: ");
+    if (lines != expectedLines.str()) ++numMismatches;
+    std::cout << "Formatting mismatches: " << numMismatches << "\n";
+    numFailures += numMismatches;
+
+    // cached results must be the same as uncached ones, including error offsets in expressions that were cached
+    // with different spaces. Each input is calculated twice, then once more with extra spaces
+    numMismatches = 0;
+    Calculator cachedCalc;
+    cachedCalc.enableCache(64);
+    std::vector<std::string> spacedInputs;
+    for (const std::string& input : inputs) {
+        std::string spaced = " ";
+        for (char c : input) (spaced += c) += ' ';
+        spacedInputs.push_back(spaced);
+    }
+    for (const std::vector<std::string>* batch : {&inputs, &inputs, &spacedInputs}) {
+        for (const std::string& input : *batch) {
+            const calc::Result expected = calc.tryCalculate(input);
+            const calc::Result actual = cachedCalc.tryCalculate(input);
+            if (describe(expected) != describe(actual) || expected.offset != actual.offset) {
+                ++numMismatches;
+                std::cout << "Cache mismatch for \"" << input << "\"\n";
+            }
+        }
+    }
+    ParallelCalculator cachedParallelCalc(4);
+    cachedParallelCalc.enableCache(1000);
+    for (unsigned int round = 0; round < 2; ++round) {
+        const std::vector<calc::Result> cachedResults = cachedParallelCalc.calculateBatch(largeBatch);
+        for (std::size_t i = 0; i < largeBatch.size(); ++i) {
+            if (describe(results[i % inputs.size()]) != describe(cachedResults[i])) {
+                ++numMismatches;
+                std::cout << "Shared cache mismatch for \"" << largeBatch[i] << "\"\n";
+            }
+        }
+    }
+    std::cout << "Cache mismatches: " << numMismatches << "\n";
+    numFailures += numMismatches;
+    std::cout << "Cache hits: " << cachedCalc.getCache()->getNumHits()
+              << ", misses: " << cachedCalc.getCache()->getNumMisses() << "\n";
+    std::cout << "Shared cache size: " << cachedParallelCalc.getCache()->size()
+              << ", misses: " << cachedParallelCalc.getCache()->getNumMisses() << "\n";
+
+    // sharing repeated subexpressions must give the same answers, errors and offsets, errors being found in the first
+    // copy of a failing subexpression. A sum of copies of the same parentheses only adds one node per copy
+    numMismatches = 0;
+    Calculator sharingCalc;
+    sharingCalc.enableSharing(true);
+    std::string repeated = "(7*(1+2)/3)";
+    for (unsigned int copy = 1; copy < 1000; ++copy) repeated += "+(7*(1+2)/3)";
+    std::vector<std::string> sharedInputs = inputs;
+    for (const char* input : {"(4/(2-2))*3+(4/(2-2))", "-(2*3)-(-(2*3))*(2*3)", "1 / 3 + 1/3 + (1 / 3)",
+                              "99999999999999999999*99999999999999999999 + 99999999999999999999*99999999999999999999"})
+        sharedInputs.emplace_back(input);
+    sharedInputs.push_back(repeated);
+    for (const std::string& input : sharedInputs) {
+        const calc::Result expected = calc.tryCalculate(input);
+        const calc::Result actual = sharingCalc.tryCalculate(input);
+        if (actual.error != expected.error || actual.offset != expected.offset
+            || !isSameDouble(actual.answer, expected.answer)) {
+            ++numMismatches;
+            std::cout << "Sharing mismatch for \"" << input << "\"\n";
+        }
+    }
+    calc::classes::FlatAST sharedTree;
+    sharedTree.enableSharing(true);
+    calc::Result parsed;
+    Calculator::parse(repeated, sharedTree, parsed);
+    std::cout << "Sharing mismatches: " << numMismatches << ", nodes for 1000 copies: " << sharedTree.size() << "\n";
+    numFailures += numMismatches;
+
+    // integer-only subtrees are evaluated exactly, so only the answer itself gets rounded. Both of these used to give 0
+    for (const char* input : {"99999999999999 + 1 - 99999999999999", "123456789012345678 - 123456789012345677"})
+        std::cout << input << " = " << calc.calculate(input) << "\n";
+
+    // formulas must give the same results as calculating them with each variable replaced by its value, however many
+    // times their variables change. Variables are set to small integers, so that divisions by zero come up too
+    numMismatches = 0;
+    const char* formulas[] = {"x*(3+4) - y/2 + 10*10", "(a+b)*(a - b)/c", "-x*-y - (z - -x)", "x/y/y/y + 2*(3)",
+                              "big_1*big_1*big_1 - big_1 * 1000000"};
+    calc::VariableTable variables;
+    std::map<std::string, int> substitutes; // same values as in variables
+    std::uniform_int_distribution<int> variableValues(-3, 3);
+    for (const char* formula : formulas) {
+        std::vector<std::pair<std::size_t, std::string>> names; // and where they are in formula
+        for (std::size_t begin = 0, end; formula[begin] != '\0'; begin = end) {
+            for (end = begin + 1; calc::utils::isLetter(formula[begin]) && (calc::utils::isLetter(formula[end])
+                     || calc::utils::isDigit(formula[end])); ++end) {}
+            if (calc::utils::isLetter(formula[begin])) names.emplace_back(begin, std::string(formula + begin, end - begin));
+        }
+
+        // one variable changes at a time, so most of the formula stays cached
+        calc::Formula compiled = Calculator::compile(formula, variables);
+        for (unsigned int round = 0; round < 50; ++round) {
+            const std::string& changed = names[round % names.size()].second;
+            substitutes[changed] = variableValues(random) * (changed == "big_1" ? 1000000 : 1);
+            variables.set(changed, substitutes[changed]);
+            if (round < names.size()) continue; // until every variable has a value
+
+            std::string substituted = formula;
+            for (auto name = names.rbegin(); name != names.rend(); ++name)
+                substituted.replace(name->first, name->second.size(), "(" + std::to_string(substitutes[name->second]) + ")");
+            const calc::Result expected = calc.tryCalculate(substituted);
+            const calc::Result actual = compiled.evaluate();
+            if (describe(expected) != describe(actual)) {
+                ++numMismatches;
+                std::cout << "Formula mismatch for \"" << formula << "\" as \"" << substituted << "\"\n";
+            }
+        }
+    }
+    std::cout << "Formula mismatches: " << numMismatches << "\n";
+    numFailures += numMismatches;
+
+    calc::Formula incremental = Calculator::compile("(x + 1)*(x - 1) + y*(2 + 3*4)", variables);
+    variables.set("x", 3);
+    variables.set("y", 4);
+    std::cout << "(x + 1)*(x - 1) + y*(2 + 3*4) = " << incremental.evaluate().answer << " with x = 3, y = 4, ";
+    variables.set("y", 5);
+    std::cout << incremental.evaluate().answer << " with y = 5, evaluating " << incremental.getNumEvaluatedNodes()
+              << " of " << incremental.size() << " nodes\n";
+    for (const char* invalid : {"2x", "x y", "x(2)", "(2)x", "x 2 + 1", "undefined + 1", "x + 1 + #"}) {
+        try {
+            calc::Formula failing = Calculator::compile(invalid, variables);
+            const calc::Result result = failing.evaluate();
+            std::cout << invalid << ": " << describe(result) << "\n";
+        } catch (const std::exception& e) { std::cout << invalid << ": " << e.what() << "\n"; }
+    }
+
+    // columnar formulas must give each row the same result as a Formula with the row's values. Inputs are small and
+    // large integers, and fractions of every magnitude, so that every kernel sees both integer and scientific rows
+    numMismatches = 0;
+    std::size_t numScalarRows = 0;
+    std::uniform_int_distribution<int> inputKinds(0, 3);
+    std::uniform_int_distribution<int> inputMagnitudes(-20, 20);
+    auto randomInput = [&] {
+        switch (inputKinds(random)) {
+        case 0: return static_cast<double>(variableValues(random));
+        case 1: return std::trunc(mantissas(random) * 1e15) * (variableValues(random) < 0 ? -1 : 1);
+        default: return mantissas(random) * std::pow(10.0, inputMagnitudes(random)) * (variableValues(random) < 0 ? -1 : 1);
+        }
+    };
+    const char* columnarFormulas[] = {"x*(3+4) - y/2 + 10*10", "(a+b)*(a - b)/c", "-x*-y - (z - -x)", "x/y/y/y + 2*(3)",
+                                      "x*x*x*x*x*x*x*x*x*x*x*x*x*x*x*x*x*x*x*x*x*x*x*x*x*x*x*x*x*x*x*x*x*x*x*x*x*x",
+                                      "123456789012345678 * x + y", "x - x*1000000", "x / (y - y) + 1"};
+    for (const char* formula : columnarFormulas) {
+        calc::ColumnarFormula columnar = Calculator::compileColumnar(formula);
+        constexpr std::size_t NUM_ROWS = 3000;
+        std::vector<std::vector<double>> columns(columnar.variableNames().size(), std::vector<double>(NUM_ROWS));
+        std::vector<const double*> columnPointers;
+        for (std::vector<double>& column : columns) {
+            for (double& input : column) input = randomInput();
+            columnPointers.push_back(column.data());
+        }
+        std::vector<calc::Result> columnarResults(NUM_ROWS);
+        columnar.evaluate(columnPointers, NUM_ROWS, columnarResults.data());
+        numScalarRows += columnar.getNumScalarRows();
+
+        calc::VariableTable rowVariables;
+        calc::Formula reference = Calculator::compile(formula, rowVariables);
+        for (std::size_t row = 0; row < NUM_ROWS; ++row) {
+            for (std::size_t c = 0; c < columns.size(); ++c) rowVariables.set(columnar.variableNames()[c], columns[c][row]);
+            const calc::Result expected = reference.evaluate();
+            const calc::Result& actual = columnarResults[row];
+            if (describe(expected) != describe(actual) || expected.offset != actual.offset) {
+                ++numMismatches;
+                if (numMismatches <= 10) std::cout << "Columnar mismatch for \"" << formula << "\" at row " << row << "\n";
+            }
+        }
+    }
+    std::cout << "Columnar mismatches: " << numMismatches << ", rows evaluated one by one: " << numScalarRows << "\n";
+    numFailures += numMismatches;
+
+    // parentheses nested up to MAX_DEPTH levels deep are parsed without recursing, one level deeper is an error at the
+    // parenthesis that opens it
+    std::string nested;
+    for (unsigned int depth = 0; depth < calc::MAX_DEPTH; ++depth) nested += "1+(";
+    nested += "1" + std::string(calc::MAX_DEPTH, ')');
+    const calc::Result nestedResult = calc.tryCalculate(nested);
+    const std::string deeper = "-(" + nested + ")";
+    const calc::Result deeperResult = calc.tryCalculate(deeper);
+    std::cout << calc::MAX_DEPTH << " levels of parentheses = " << nestedResult.answer << " ("
+              << calc.execute(Calculator::compile(nested)) << " compiled), "
+              << calc::MAX_DEPTH + 1 << " levels: " << deeperResult.message() << " at offset " << deeperResult.offset
+              << "\n";
+
+    // trees as deep as their expression is long are evaluated without recursing either
+    std::string deepTree = "1";
+    for (unsigned int term = 0; term < 1000000; ++term) deepTree += term % 2 == 0 ? "*3-2" : "+1";
+    std::cout << "Tree 1000000 operations deep = " << calc.calculate(deepTree) << " ("
+              << calc.execute(Calculator::compile(deepTree)) << " compiled)\n";
+
+    // a long sum of literals is evaluated as one fold, still checking the bounds of every partial result
+    const std::string huge(calc::MAX_MAGNITUDE, '9');
+    std::string overflowingSum = "1";
+    for (unsigned int term = 0; term < 1000; ++term) overflowingSum += "+1";
+    for (unsigned int term = 0; term < 20; ++term) overflowingSum += (term < 10 ? "+" : "-") + huge;
+    const calc::Result overflowingResult = calc.tryCalculate(overflowingSum);
+    std::cout << "Sum back in range after overflowing: " << overflowingResult.message() << " at offset "
+              << overflowingResult.offset << "\n";
+
+    // statistics are only collected when built with CALC_STATS
+    calc::stats::reset();
+    Calculator statsCalc;
+    for (const char* input : {"(1+2)*3", "1/0", "4+"}) {
+        try { statsCalc.calculate(input); }
+        catch (const std::exception&) {}
+    }
+    const calc::stats::Snapshot stats = calc::stats::snapshot();
+    if (!stats.isEnabled) std::cout << "Stats disabled\n";
+    for (std::size_t c = 0; stats.isEnabled && c < static_cast<std::size_t>(calc::stats::Counter::NUM_COUNTERS); ++c) {
+        const auto counter = static_cast<calc::stats::Counter>(c);
+        std::cout << calc::stats::name(counter) << ": ";
+        if (counter == calc::stats::Counter::Allocations || counter == calc::stats::Counter::BytesAllocated)
+            std::cout << (stats[counter] > 0 ? "counted" : "none") << "\n"; // depends on the standard library
+        else std::cout << stats[counter] << "\n";
+    }
+    for (std::size_t p = 0; stats.isEnabled && p < static_cast<std::size_t>(calc::stats::Phase::NUM_PHASES); ++p) {
+        const auto phase = static_cast<calc::stats::Phase>(p);
+        std::cout << calc::stats::name(phase) << " timed " << stats[phase].count << " times\n";
+    }
+
+    // counts of other threads must be flushed by the time their entry points return, not only by calculate()
+    if (stats.isEnabled) {
+        const auto countOnOtherThread = [&](auto entryPoint) {
+            using calc::stats::Counter;
+            const unsigned long long before = calc::stats::snapshot()[Counter::MakeScientificCalls];
+            std::thread(entryPoint).join();
+            const bool isFlushed = calc::stats::snapshot()[Counter::MakeScientificCalls] > before;
+            if (!isFlushed) ++numFailures;
+            return isFlushed ? "flushed" : "lost";
+        };
+        const calc::classes::Program statsProgram = Calculator::compile("1/3");
+        calc::VariableTable statsVariables;
+        calc::Formula statsFormula = Calculator::compile("x/3", statsVariables);
+        std::cout << "makeScientific() calls of other threads: compile "
+                  << countOnOtherThread([] { (void)Calculator::compile("999999999999995*100000"); })
+                  << ", execute " << countOnOtherThread([&] { (void)Calculator().execute(statsProgram); })
+                  << ", variables " << countOnOtherThread([&] { statsVariables.set("x", 0.5); })
+                  << ", formula " << countOnOtherThread([&] { (void)statsFormula.evaluate(); }) << "\n";
+    }
+
+#if defined(CALC_DECIMAL_BACKEND)
+    // the decimal backend must find the same errors at the same offsets, and the same answers once they are rounded to
+    // MAX_DIGITS digits
+    numMismatches = 0;
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+        const calc::DecimalResult decimalResult = calc.tryCalculateDecimal(inputs[i]);
+        const bool isSame = decimalResult.error == results[i].error && decimalResult.offset == results[i].offset
+            && (!decimalResult || std::strtod(decimalResult.answer.toString(calc::MAX_DIGITS).c_str(), nullptr)
+                   == results[i].answer);
+        if (!isSame) {
+            ++numMismatches;
+            std::cout << "Decimal backend mismatch for \"" << inputs[i] << "\"\n";
+        }
+    }
+    std::cout << "Decimal backend mismatches: " << numMismatches << "\n";
+    numFailures += numMismatches;
+
+    for (const char* input : {"1/3", "2/3", "123456789012345678901234567890*3", "10/4/5/5/5/5/5/5/5/5/5/5/5/5",
+                              "999999999999999999999999999999999999999 - 1", "1 - 1/1000000000000000000000000000000000"})
+        std::cout << input << " = " << calc.tryCalculateDecimal(input).answer.toString() << "\n";
+#endif
+
+    // where tryCalculate() finds the error of each invalid input
+    testCaseNumber = 0;
+    for (const std::string& input : inputs) {
+        ++testCaseNumber;
+        const calc::Result result = calc.tryCalculate(input);
+        if (!result) std::cout << testCaseNumber << ".)  error at offset " << result.offset << "\n";
+    }
+    return numFailures == 0 ? 0 : 1;
 }
\ No newline at end of file
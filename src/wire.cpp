@@ -0,0 +1,368 @@
+#include "wire.h"
+
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+
+// Encoding
+namespace {
+	using calc::ErrorCode;
+	using calc::classes::Instruction;
+	using calc::classes::Number;
+	using calc::classes::OpCode;
+	using calc::wire::MessageType;
+	using calc::wire::WireError;
+
+	// opcodes of the wire format, kept apart from OpCode so that OpCode can change without breaking stored messages
+	enum class WireOp : unsigned char { PushInteger, PushScientific, Negate, Add, Subtract, Multiply, Divide };
+
+	constexpr OpCode BINARY_OPS[] = {OpCode::Add, OpCode::Subtract, OpCode::Multiply, OpCode::Divide}; // WireOp::Add on
+
+	enum class AnswerForm : unsigned char { Integer, Double };
+
+	// errors of the wire format, kept apart from ErrorCode for the same reason, so new ones only go at the end
+	enum class WireErrorCode : unsigned char {
+		None, EmptyExpression, InvalidCharacter, InvalidUnaryOperator, AdjacentOperators, LeadingOperator,
+		UnmatchedOpenParenthesis, UnmatchedClosedParenthesis, EmptyParentheses, NestingTooDeep, MissingOperator,
+		UndefinedVariable, Overflow, DivisionByZero
+	};
+
+	constexpr ErrorCode ERROR_CODES[] = { // indexed by WireErrorCode
+		ErrorCode::None, ErrorCode::EmptyExpression, ErrorCode::InvalidCharacter, ErrorCode::InvalidUnaryOperator,
+		ErrorCode::AdjacentOperators, ErrorCode::LeadingOperator, ErrorCode::UnmatchedOpenParenthesis,
+		ErrorCode::UnmatchedClosedParenthesis, ErrorCode::EmptyParentheses, ErrorCode::NestingTooDeep,
+		ErrorCode::MissingOperator, ErrorCode::UndefinedVariable, ErrorCode::Overflow, ErrorCode::DivisionByZero
+	};
+	static_assert(std::size(ERROR_CODES) == static_cast<std::size_t>(WireErrorCode::DivisionByZero) + 1);
+
+	constexpr std::size_t HEADER_SIZE = 2; // type and version
+	constexpr std::size_t DOUBLE_SIZE = 8;
+	constexpr double MAX_INTEGER_ANSWER = 9007199254740992.0; // 2 ^ 53, every integer up to it is exact in double
+
+	unsigned long long zigzag(long long value) {
+		return (static_cast<unsigned long long>(value) << 1) ^ static_cast<unsigned long long>(value >> 63);
+	}
+
+	long long unzigzag(unsigned long long value) {
+		return static_cast<long long>(value >> 1) ^ -static_cast<long long>(value & 1);
+	}
+
+	std::size_t varintSize(unsigned long long value) {
+		std::size_t size = 1;
+		while (value >= 0x80) {
+			value >>= 7;
+			++size;
+		}
+		return size;
+	}
+
+	bool isIntegerAnswer(double answer) {
+		return std::abs(answer) <= MAX_INTEGER_ANSWER && std::trunc(answer) == answer && !std::signbit(answer);
+	}
+
+	WireOp toWireOp(const Instruction& instruction) {
+		switch (instruction.op) {
+		case OpCode::Push: return instruction.constant.isInteger ? WireOp::PushInteger : WireOp::PushScientific;
+		case OpCode::Negate: return WireOp::Negate;
+		case OpCode::Add: return WireOp::Add;
+		case OpCode::Subtract: return WireOp::Subtract;
+		case OpCode::Multiply: return WireOp::Multiply;
+		case OpCode::Divide: return WireOp::Divide;
+		}
+		return WireOp::Negate;
+	}
+
+	constexpr WireErrorCode toWireErrorCode(ErrorCode error) {
+		switch (error) {
+		case ErrorCode::None: return WireErrorCode::None;
+		case ErrorCode::EmptyExpression: return WireErrorCode::EmptyExpression;
+		case ErrorCode::InvalidCharacter: return WireErrorCode::InvalidCharacter;
+		case ErrorCode::InvalidUnaryOperator: return WireErrorCode::InvalidUnaryOperator;
+		case ErrorCode::AdjacentOperators: return WireErrorCode::AdjacentOperators;
+		case ErrorCode::LeadingOperator: return WireErrorCode::LeadingOperator;
+		case ErrorCode::UnmatchedOpenParenthesis: return WireErrorCode::UnmatchedOpenParenthesis;
+		case ErrorCode::UnmatchedClosedParenthesis: return WireErrorCode::UnmatchedClosedParenthesis;
+		case ErrorCode::EmptyParentheses: return WireErrorCode::EmptyParentheses;
+		case ErrorCode::NestingTooDeep: return WireErrorCode::NestingTooDeep;
+		case ErrorCode::MissingOperator: return WireErrorCode::MissingOperator;
+		case ErrorCode::UndefinedVariable: return WireErrorCode::UndefinedVariable;
+		case ErrorCode::Overflow: return WireErrorCode::Overflow;
+		case ErrorCode::DivisionByZero: return WireErrorCode::DivisionByZero;
+		}
+		return WireErrorCode::None;
+	}
+
+	constexpr bool isErrorTableConsistent() { // decoding what was encoded gives the same error
+		for (std::size_t i = 0; i < std::size(ERROR_CODES); ++i)
+			if (static_cast<std::size_t>(toWireErrorCode(ERROR_CODES[i])) != i) return false;
+		return true;
+	}
+	static_assert(isErrorTableConsistent());
+
+	struct Writer { // unchecked, the size of the message is checked against the capacity beforehand
+		unsigned char* out;
+
+		void byte(unsigned char value) { *out++ = value; }
+
+		void varint(unsigned long long value) {
+			while (value >= 0x80) {
+				*out++ = static_cast<unsigned char>(value | 0x80);
+				value >>= 7;
+			}
+			*out++ = static_cast<unsigned char>(value);
+		}
+
+		void number(double value) {
+			std::uint64_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			for (std::size_t i = 0; i < DOUBLE_SIZE; ++i) *out++ = static_cast<unsigned char>(bits >> (8 * i));
+		}
+
+		void header(MessageType type) {
+			byte(static_cast<unsigned char>(type));
+			byte(calc::wire::VERSION);
+		}
+	};
+
+	struct Reader {
+		const unsigned char* in;
+		const unsigned char* end;
+
+		WireError byte(unsigned char& value) {
+			if (in == end) return WireError::Truncated;
+			value = *in++;
+			return WireError::None;
+		}
+
+		WireError varint(unsigned long long& value) {
+			value = 0;
+			for (unsigned int shift = 0; shift < 64; shift += 7) {
+				if (in == end) return WireError::Truncated;
+				const unsigned char b = *in++;
+				if (shift == 63 && b > 1) return WireError::Malformed; // more than 64 bits
+				value |= static_cast<unsigned long long>(b & 0x7F) << shift;
+				if ((b & 0x80) == 0) return WireError::None;
+			}
+			return WireError::Malformed;
+		}
+
+		WireError number(double& value) {
+			if (static_cast<std::size_t>(end - in) < DOUBLE_SIZE) return WireError::Truncated;
+			std::uint64_t bits = 0;
+			for (std::size_t i = 0; i < DOUBLE_SIZE; ++i) bits |= static_cast<std::uint64_t>(*in++) << (8 * i);
+			std::memcpy(&value, &bits, sizeof(value));
+			return WireError::None;
+		}
+
+		WireError header(MessageType type) {
+			if (static_cast<std::size_t>(end - in) < HEADER_SIZE) return WireError::Truncated;
+			if (in[0] != static_cast<unsigned char>(type)) return WireError::Malformed;
+			if (in[1] != calc::wire::VERSION) return WireError::UnsupportedVersion;
+			in += HEADER_SIZE;
+			return WireError::None;
+		}
+
+		[[nodiscard]] std::size_t remaining() const { return static_cast<std::size_t>(end - in); }
+	};
+
+	constexpr double MANTISSA_TOLERANCE = 1e-12; // relative, far more than the few ulps makeScientific() is off by
+
+	bool isValidScientific(double value, long long magnitude) {
+		// the form that makeScientific() gives: 0, or a value with one digit before the point. Rounding up gives 10,
+		// as in 999999999999995 * 100000 = 10 * 10 ^ 19, and dividing by the power of ten can end a few ulps outside
+		// [1, 10]
+		if (magnitude < -static_cast<long long>(calc::MAX_MAGNITUDE)
+			|| magnitude > static_cast<long long>(calc::MAX_MAGNITUDE)) return false;
+		if (value == 0) return magnitude == 0;
+		const double absolute = std::abs(value);
+		return absolute >= 1 - MANTISSA_TOLERANCE && absolute <= 10 + 10 * MANTISSA_TOLERANCE; // false for inf and NaN
+	}
+}
+
+const char* calc::wire::errorMessage(WireError error) {
+	switch (error) {
+	case WireError::None: return "No error";
+	case WireError::Truncated: return "Truncated message";
+	case WireError::Malformed: return "Malformed message";
+	case WireError::UnsupportedVersion: return "Unsupported version of the wire format";
+	}
+	return "Unknown error";
+}
+
+
+// Programs
+std::size_t calc::wire::encodedSize(const classes::Program& program) {
+	const std::vector<Instruction>& code = program.instructions();
+	std::size_t size = HEADER_SIZE + varintSize(code.size());
+	for (std::size_t i = 0; i < code.size(); ++i) {
+		const Instruction& instruction = code[i];
+		++size; // opcode
+		switch (toWireOp(instruction)) {
+		case WireOp::PushInteger: size += varintSize(zigzag(instruction.constant.integer)); break;
+		case WireOp::PushScientific: size += DOUBLE_SIZE + varintSize(zigzag(instruction.constant.magnitude)); break;
+		case WireOp::Negate: break;
+		default: size += varintSize(program.position(i)); break;
+		}
+	}
+	return size;
+}
+
+std::size_t calc::wire::encode(const classes::Program& program, unsigned char* out, std::size_t capacity) {
+	const std::size_t size = encodedSize(program);
+	if (size > capacity) return 0;
+
+	const std::vector<Instruction>& code = program.instructions();
+	for (const Instruction& instruction : code) { // so that everything encoded decodes
+		if (toWireOp(instruction) == WireOp::PushScientific
+			&& !isValidScientific(instruction.constant.value, instruction.constant.magnitude)) return 0;
+	}
+	Writer writer{out};
+	writer.header(MessageType::Program);
+	writer.varint(code.size());
+	for (std::size_t i = 0; i < code.size(); ++i) {
+		const Instruction& instruction = code[i];
+		const WireOp op = toWireOp(instruction);
+		writer.byte(static_cast<unsigned char>(op));
+		switch (op) {
+		case WireOp::PushInteger: writer.varint(zigzag(instruction.constant.integer)); break;
+		case WireOp::PushScientific:
+			writer.number(instruction.constant.value);
+			writer.varint(zigzag(instruction.constant.magnitude));
+			break;
+		case WireOp::Negate: break;
+		default: writer.varint(program.position(i)); break;
+		}
+	}
+	return size;
+}
+
+calc::wire::WireError calc::wire::decode(
+	const unsigned char* in, std::size_t size, classes::Program& program, std::size_t& consumed) {
+	program.clear();
+	Reader reader{in, in + size};
+	WireError error = reader.header(MessageType::Program);
+	if (error != WireError::None) return error;
+
+	unsigned long long numInstructions;
+	if ((error = reader.varint(numInstructions)) != WireError::None) return error;
+	if (numInstructions > reader.remaining()) return WireError::Truncated; // each instruction takes at least one byte
+	if (numInstructions == 0) return WireError::Malformed;
+
+	std::size_t depth = 0; // values on the stack, so that the program can't pop more than it pushed
+	for (unsigned long long i = 0; i < numInstructions; ++i) {
+		unsigned char opByte;
+		if ((error = reader.byte(opByte)) != WireError::None) return error;
+		if (opByte > static_cast<unsigned char>(WireOp::Divide)) return WireError::Malformed;
+
+		Instruction instruction{OpCode::Push, {}};
+		unsigned long long position = 0;
+		unsigned long long n;
+		switch (static_cast<WireOp>(opByte)) {
+		case WireOp::PushInteger: {
+			if ((error = reader.varint(n)) != WireError::None) return error;
+			const long long integer = unzigzag(n);
+			if (integer < -Number::MAX_INTEGER) return WireError::Malformed; // out of the range of Number
+			instruction.constant = Number(integer);
+			++depth;
+			break;
+		}
+		case WireOp::PushScientific: {
+			double value;
+			if ((error = reader.number(value)) != WireError::None) return error;
+			if ((error = reader.varint(n)) != WireError::None) return error;
+			const long long magnitude = unzigzag(n);
+			if (!isValidScientific(value, magnitude)) return WireError::Malformed;
+			instruction.constant = Number(classes::ScientificValue(value, static_cast<int>(magnitude)));
+			++depth;
+			break;
+		}
+		case WireOp::Negate:
+			if (depth < 1) return WireError::Malformed;
+			instruction.op = OpCode::Negate;
+			break;
+
+		default:
+			if ((error = reader.varint(position)) != WireError::None) return error;
+			if (depth < 2 || position > UINT_MAX) return WireError::Malformed;
+			instruction.op = BINARY_OPS[opByte - static_cast<unsigned char>(WireOp::Add)];
+			--depth;
+			break;
+		}
+		program.append(instruction, static_cast<unsigned int>(position));
+	}
+	if (depth != 1) return WireError::Malformed;
+
+	consumed = static_cast<std::size_t>(reader.in - in);
+	return WireError::None;
+}
+
+
+// Results
+std::size_t calc::wire::encodedSize(const Result& result) {
+	std::size_t size = HEADER_SIZE + 1; // error
+	if (!result) return size + varintSize(result.offset);
+	++size; // form of the answer
+	if (isIntegerAnswer(result.answer)) return size + varintSize(zigzag(static_cast<long long>(result.answer)));
+	return size + DOUBLE_SIZE;
+}
+
+std::size_t calc::wire::encode(const Result& result, unsigned char* out, std::size_t capacity) {
+	const std::size_t size = encodedSize(result);
+	if (size > capacity) return 0;
+
+	Writer writer{out};
+	writer.header(MessageType::Result);
+	writer.byte(static_cast<unsigned char>(toWireErrorCode(result.error)));
+	if (!result) writer.varint(result.offset);
+	else if (isIntegerAnswer(result.answer)) {
+		writer.byte(static_cast<unsigned char>(AnswerForm::Integer));
+		writer.varint(zigzag(static_cast<long long>(result.answer)));
+	}
+	else {
+		writer.byte(static_cast<unsigned char>(AnswerForm::Double));
+		writer.number(result.answer);
+	}
+	return size;
+}
+
+calc::wire::WireError calc::wire::decode(const unsigned char* in, std::size_t size, Result& result,
+	std::size_t& consumed) {
+	result = Result();
+	Reader reader{in, in + size};
+	WireError error = reader.header(MessageType::Result);
+	if (error != WireError::None) return error;
+
+	unsigned char errorByte;
+	if ((error = reader.byte(errorByte)) != WireError::None) return error;
+	if (errorByte >= std::size(ERROR_CODES)) return WireError::Malformed;
+	result.error = ERROR_CODES[errorByte];
+
+	if (!result) {
+		unsigned long long offset;
+		if ((error = reader.varint(offset)) != WireError::None) return error;
+		if (offset > UINT_MAX) return WireError::Malformed;
+		result.offset = static_cast<unsigned int>(offset);
+	}
+	else {
+		unsigned char form;
+		if ((error = reader.byte(form)) != WireError::None) return error;
+		if (form == static_cast<unsigned char>(AnswerForm::Integer)) {
+			unsigned long long n;
+			if ((error = reader.varint(n)) != WireError::None) return error;
+			const long long answer = unzigzag(n);
+			if (std::abs(static_cast<double>(answer)) > MAX_INTEGER_ANSWER) return WireError::Malformed;
+			result.answer = static_cast<double>(answer);
+		}
+		else if (form == static_cast<unsigned char>(AnswerForm::Double)) {
+			if ((error = reader.number(result.answer)) != WireError::None) return error;
+		}
+		else return WireError::Malformed;
+	}
+
+	consumed = static_cast<std::size_t>(reader.in - in);
+	return WireError::None;
+}
@@ -0,0 +1,56 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include "calculator.h"
+
+#include <cstddef>
+
+
+// Wire Format
+// compact binary encoding of compiled programs and of results, to send them between processes or store them without
+// going back through the expression's text. Every message starts with its type and VERSION, one byte each. Integers are
+// written as LEB128 varints (signed ones zigzag-encoded first, so that small negative values stay short) and doubles as
+// their 8 bytes in little-endian order, so messages read the same on every platform.
+// Neither encode() nor decode() allocates: encode() writes into the caller's buffer, and decode() reuses the capacity
+// of the program it decodes into. decode() validates everything it reads, so messages from untrusted sources can't
+// give a program that breaks the stack machine or a Number out of its range
+namespace calc::wire {
+
+    inline constexpr unsigned char VERSION = 1; // increased for each change to the format
+
+    enum class MessageType : unsigned char { Program = 1, Result = 2 };
+
+    enum class WireError : unsigned char {
+        None,
+        Truncated, // the message needs more bytes than given
+        Malformed, // unknown type or opcode, invalid value or unbalanced program
+        UnsupportedVersion
+    };
+
+    const char* errorMessage(WireError error);
+
+    // Programs
+    // each instruction is its opcode, followed by the constant of Push and the position of binary operations. Push and
+    // Negate can't cause errors, so their positions aren't kept and are decoded as 0
+    [[nodiscard]] std::size_t encodedSize(const classes::Program& program);
+
+    std::size_t encode(const classes::Program& program, unsigned char* out, std::size_t capacity);
+    // returns the number of bytes written, or 0 without writing anything when capacity is less than encodedSize() or
+    // when a constant isn't in the form decode() accepts
+
+    WireError decode(const unsigned char* in, std::size_t size, classes::Program& program, std::size_t& consumed);
+    // consumed is set to the size of the message on success, which can be followed by other messages. program is
+    // left cleared or partially decoded on errors. Empty programs are malformed, since they can't be executed
+
+    // Results
+    // errors are kept with their offset. Answers that are integers of up to 53 bits are written as varints, others as
+    // their double, so that every answer is decoded exactly
+    [[nodiscard]] std::size_t encodedSize(const Result& result);
+
+    std::size_t encode(const Result& result, unsigned char* out, std::size_t capacity);
+
+    WireError decode(const unsigned char* in, std::size_t size, Result& result, std::size_t& consumed);
+
+}
+
+#endif //WIRE_H